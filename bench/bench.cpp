@@ -0,0 +1,446 @@
+//
+//  molencalc-bench
+//
+//  Microbenchmarks for the calculator's hot paths, run headless on the host.
+//  Results are written to stdout as JSON so different builds can be compared.
+//
+//  usage: molencalc-bench [-t min_ms_per_bench] [name_filter]
+//
+
+#include "drivers/lcd.h"
+#include "host/lcdsim.h"
+#include "libcalc/animrender.h"
+#include "libcalc/font.h"
+#include "libcalc/format.h"
+#include "libcalc/funcs.h"
+#include "libcalc/libcalc.h"
+#include "libcalc/parser.h"
+#include "libcalc/plot.h"
+#include "libcalc/session.h"
+#include "libcalc/symbols.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+using BenchClock = std::chrono::steady_clock;
+
+static double gMinSeconds = 0.25;
+static const char* gFilter = nullptr;
+static bool gFirstResult = true;
+
+// results get folded in here so the optimiser can't throw the work away
+static volatile double gSink = 0.0;
+
+static void silent_puts(const char*)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+
+template<typename Fn>
+static double time_iterations(Fn& fn, long iterations)
+{
+    const BenchClock::time_point start = BenchClock::now();
+    for (long i = 0; i < iterations; ++i)
+        fn();
+    const BenchClock::time_point end = BenchClock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+template<typename Fn>
+static void bench(const char* name, Fn fn)
+{
+    if (gFilter && !strstr(name, gFilter))
+        return;
+
+    // find an iteration count that takes long enough to measure, then do a proper run
+    long iterations = 1;
+    double seconds = time_iterations(fn, iterations);
+    while (seconds < gMinSeconds / 10)
+    {
+        iterations *= 4;
+        seconds = time_iterations(fn, iterations);
+    }
+
+    iterations = long(iterations * (gMinSeconds / seconds)) + 1;
+    lcdsim_reset_stats();
+    seconds = time_iterations(fn, iterations);
+
+    const double nsPerOp = (seconds * 1.0e9) / iterations;
+    const double opsPerSec = iterations / seconds;
+
+    printf("%s\n    { \"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.2f, \"ops_per_sec\": %.1f",
+        gFirstResult ? "" : ",", name, iterations, nsPerOp, opsPerSec);
+
+    // anything that draws on the simulated lcd also says how much it had to send
+    const LcdSimStats& lcd = lcdsim_stats();
+    if (lcd.CmdBytes + lcd.DataBytes > 0)
+    {
+        printf(", \"spi_bytes_per_op\": %.1f, \"windows_per_op\": %.1f",
+            double(lcd.CmdBytes + lcd.DataBytes) / iterations, double(lcd.WindowSets) / iterations);
+    }
+
+    printf(" }");
+    fflush(stdout);
+
+    gFirstResult = false;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void eval_or_die(const char* expr)
+{
+    char resBuf[256];
+    if (!calc_eval(expr, resBuf, sizeof(resBuf)))
+    {
+        fprintf(stderr, "bench setup failed on '%s':\n%s\n", expr, resBuf);
+        exit(1);
+    }
+}
+
+// fill the symbol and function tables up so lookups see realistic (worst) cases
+static void setup_calc()
+{
+    calc_init(silent_puts);
+
+    eval_or_die("x = 3/2");
+    eval_or_die("y = pi");
+    eval_or_die("z = 2.2k");
+
+    // leave a symbol slot free for theta below
+    char line[64];
+    for (int i = 0; i < 19; ++i)
+    {
+        snprintf(line, sizeof(line), "pad%d = %d", i, i);
+        eval_or_die(line);
+    }
+    eval_or_die("last = 42");
+
+    for (int i = 0; i < 4; ++i)
+    {
+        snprintf(line, sizeof(line), "padf%d(x) = x + %d", i, i);
+        eval_or_die(line);
+    }
+    eval_or_die("f(x) = sin(x^2)");
+    eval_or_die("ps(x) = sin(x)");
+    eval_or_die("pf(t) = sin(t)*t + 1");
+    eval_or_die("pn(x) = pf(x)^2 + pf(x/2) - pf(3x)");
+    eval_or_die("q(x) = 3x^2 + 2x + 1");
+    eval_or_die("flast(x) = x");
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void bench_calc_eval()
+{
+    char resBuf[256];
+
+    bench("calc_eval/arith", [&]{ calc_eval("1+2 * 3!", resBuf, sizeof(resBuf)); });
+    bench("calc_eval/builtins", [&]{ calc_eval("sin(ln(e))*2pi/3 + sqrt(2)", resBuf, sizeof(resBuf)); });
+    bench("calc_eval/vars", [&]{ calc_eval("x*y + z/last", resBuf, sizeof(resBuf)); });
+    bench("calc_eval/user_func", [&]{ calc_eval("f(1.5) + pn(2)", resBuf, sizeof(resBuf)); });
+    bench("calc_eval/define_value", [&]{ calc_eval("theta = 2pi/3", resBuf, sizeof(resBuf)); });
+    bench("calc_eval/define_func", [&]{ calc_eval("q(x) = 3x^2 + 2x + 1", resBuf, sizeof(resBuf)); });
+}
+
+static void tokenise(const char* line)
+{
+    ParseCtx ctx { .InBuffer = line };
+    do
+    {
+        advance_token(ctx);
+        gSink = gSink + ctx.TokenNumber;
+    }
+    while (!ctx.Error && ctx.NextToken != Token::Eof && ctx.NextToken != Token::Invalid);
+}
+
+static void bench_parser()
+{
+    const char* longExpr =
+        "sin(theta)*2pi/3 + sqrt(x^2 + y^2) - ln(e)*(1+2+3+4+5) + atan(z/last) "
+        "- 4!/(2.2k*4.7m) + cos(omega*t + phase) * signal_amplitude";
+    bench("advance_token/long_line", [&]{ tokenise(longExpr); });
+
+    const char* longNumbers =
+        "3.14159 2.2k 4.7m 100n 1.5e-3 0.000123 6.02e23 47u 10p 1G 33M 0.5 123456.789 "
+        "1 2 3 4 5 6 7 8 9 10 1.0 2.0 3.0 4.0 5.0 6.0 7.0 8.0 9.0 10.0 .5 .25 .125";
+    bench("parse_number/long_line", [&]{ tokenise(longNumbers); });
+}
+
+static void bench_lookups()
+{
+    char resBuf[64];
+    ParseCtx ctx { .InBuffer = "", .ResBuffer = resBuf, .ResBufferLen = sizeof(resBuf) };
+
+    const CalcSession& session = *calc_default_session();
+
+    double val = 0.0;
+    bench("eval_named_value/builtin", [&]{ eval_named_value(session, "e", val); gSink = gSink + val; });
+    bench("eval_named_value/last_user", [&]{ eval_named_value(session, "last", val); gSink = gSink + val; });
+    bench("eval_named_value/missing", [&]{ eval_named_value(session, "nope", val); gSink = gSink + val; });
+
+    bench("eval_function/builtin_last", [&]{ eval_function("sqrt", 2.0, val, ctx); gSink = gSink + val; });
+    bench("eval_function/user_last", [&]{ eval_function("flast", 2.0, val, ctx); gSink = gSink + val; });
+}
+
+static void bench_batch()
+{
+    char resBuf[64];
+    ParseCtx ctx { .InBuffer = "", .ResBuffer = resBuf, .ResBufferLen = sizeof(resBuf) };
+
+    constexpr int kNumXs = 240;
+    static double xs[kNumXs];
+    static double ys[kNumXs];
+    for (int i = 0; i < kNumXs; ++i)
+        xs[i] = -10.0 + (20.0 * i) / kNumXs;
+
+    const CalcSession& session = *calc_default_session();
+    const UserFunction* simple = lookup_user_func(session, "ps");
+    const UserFunction* nested = lookup_user_func(session, "pn");
+    const UserFunction* poly = lookup_user_func(session, "q");
+
+    bench("eval_user_func/scalar_x240", [&]
+    {
+        for (int i = 0; i < kNumXs; ++i)
+            ys[i] = eval_user_func(poly, xs[i], ctx);
+        gSink = gSink + ys[7];
+    });
+    bench("eval_user_func_batch/poly_240", [&]{ eval_user_func_batch(poly, xs, ys, kNumXs, ctx); gSink = gSink + ys[7]; });
+    bench("eval_user_func_batch/simple_240", [&]{ eval_user_func_batch(simple, xs, ys, kNumXs, ctx); gSink = gSink + ys[7]; });
+    bench("eval_user_func_batch/nested_240", [&]{ eval_user_func_batch(nested, xs, ys, kNumXs, ctx); gSink = gSink + ys[7]; });
+
+    Interval range = make_interval(-1.25, -1.0);
+    bench("eval_user_func_interval/simple", [&]{ gSink = gSink + eval_user_func_interval(simple, range, ctx).Hi; });
+    bench("eval_user_func_interval/nested", [&]{ gSink = gSink + eval_user_func_interval(nested, range, ctx).Hi; });
+}
+
+static void bench_plot()
+{
+    char resBuf[64];
+    ParseCtx ctx { .InBuffer = "", .ResBuffer = resBuf, .ResBufferLen = sizeof(resBuf) };
+
+    PlotAxis x { .Name = "x", .Lo = -10, .Hi = 10 };
+    PlotAxis y { .Name = "y", .Lo = -2, .Hi = 2 };
+
+    bench("draw_plot/simple", [&]{ draw_plot("ps", &x, &y, ctx); });
+    bench("draw_plot/nested", [&]{ draw_plot("pn", &x, &y, ctx); });
+
+    if (ctx.Error)
+    {
+        fprintf(stderr, "draw_plot failed:\n%s\n", resBuf);
+        exit(1);
+    }
+
+    static uint16_t row[MC_PLOT_WIDTH];
+    const Plot* plot = get_plot();
+    int rowY = 0;
+    bench("get_plot_row", [&]
+    {
+        get_plot_row(plot, rowY, row);
+        rowY = (rowY + 1) % MC_PLOT_HEIGHT;
+        gSink = gSink + row[rowY];
+    });
+}
+
+static void bench_format()
+{
+    char buf[32];
+    const double vals[] = { 13.0, 8.8249778, -0.7568025, 1.0e-12, 6.02e23, 2200.0047, 1.0/3.0, 0.0 };
+    int ix = 0;
+
+    bench("dtostr_human", [&]
+    {
+        dtostr_human(vals[ix], buf, sizeof(buf));
+        ix = (ix + 1) % int(sizeof(vals) / sizeof(vals[0]));
+        gSink = gSink + buf[0];
+    });
+}
+
+static void bench_font()
+{
+    static uint16_t buf[FONT_MAX_WIDTH * FONT_MAX_HEIGHT];
+    char c = ' ';
+
+    auto next_char = [&c]
+    {
+        if (++c > '~')
+            c = ' ';
+    };
+
+    bench("font_rasterise_char/5x10", [&]
+    {
+        font_rasterise_char(&font_5x10, c, 0xffff, 0x0000, buf, font_5x10.Width, font_5x10.Height, 0, 0);
+        next_char();
+        gSink = gSink + buf[7];
+    });
+    bench("font_rasterise_char/10x16", [&]
+    {
+        font_rasterise_char(&font_10x16, c, 0xffff, 0x0000, buf, font_10x16.Width, font_10x16.Height, 0, 0);
+        next_char();
+        gSink = gSink + buf[7];
+    });
+
+    // results use a small set of characters, so mostly hit the cache
+    const char* digits = "  = -0.123456789e";
+    int digitIx = 0;
+    bench("font_get_glyph/10x16", [&]
+    {
+        GlyphMetric metric;
+        const uint16_t* glyph = font_get_glyph(&font_10x16, digits[digitIx], 0xffff, 0x0000, false, &metric);
+        digitIx = (digitIx + 1) % int(strlen(digits));
+        gSink = gSink + glyph[7];
+    });
+    bench("font_get_glyph_metric/10x16", [&]
+    {
+        gSink = gSink + font_get_glyph_metric(&font_10x16, c, false).Advance;
+        next_char();
+    });
+}
+
+static void bench_scope()
+{
+    static TinyScopeFrameBuf fb;
+    static uint16_t row[TinyScopeFrameBuf::IMGW];
+
+    // a sparse-ish trace, like the chaos animations leave behind
+    unsigned int seed = 1;
+    auto scatter = [&seed](int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            fb.plot((seed >> 8) % TinyScopeFrameBuf::IMGW, (seed >> 20) % TinyScopeFrameBuf::IMGH);
+        }
+    };
+
+    bench("TinyScopeFrameBuf::tick", [&]{ scatter(2000); fb.tick(); });
+
+    scatter(20000);
+    int y = 0;
+    bench("TinyScopeFrameBuf::getRow", [&]
+    {
+        fb.getRow(y, row);
+        y = (y + 1) % TinyScopeFrameBuf::IMGH;
+        gSink = gSink + row[y];
+    });
+}
+
+static void get_plot_lcd_row(const void* plot, uint32_t y, uint16_t* row)
+{
+    get_plot_row((const Plot*)plot, int(y), row);
+}
+
+// the lcd driver, drawing onto the simulated lcd
+static void bench_lcd()
+{
+    lcdsim_attach();
+    lcd_init();
+
+    bench("lcd_emit_str/result", [&]{ lcd_emit_str("  = 8.8249778\n"); });
+
+    char resBuf[64];
+    ParseCtx ctx { .InBuffer = "", .ResBuffer = resBuf, .ResBufferLen = sizeof(resBuf) };
+    PlotAxis x { .Name = "x", .Lo = -10, .Hi = 10 };
+    PlotAxis y { .Name = "y", .Lo = -2, .Hi = 2 };
+    draw_plot("ps", &x, &y, ctx);
+
+    const Plot* plot = get_plot();
+    bench("lcd_put_image_rows/plot", [&]{ lcd_put_image_rows(plot, get_plot_lcd_row, MC_PLOT_WIDTH, MC_PLOT_HEIGHT); });
+
+    static uint16_t plotPixels[MC_PLOT_WIDTH * MC_PLOT_HEIGHT];
+    for (int row = 0; row < MC_PLOT_HEIGHT; ++row)
+        get_plot_lcd_row(plot, row, plotPixels + (row * MC_PLOT_WIDTH));
+    bench("lcd_put_image/plot", [&]{ lcd_put_image(plotPixels, MC_PLOT_WIDTH, MC_PLOT_HEIGHT); });
+    bench("lcd_put_image_reveal/plot", [&]{ lcd_put_image_reveal(plotPixels, MC_PLOT_WIDTH, MC_PLOT_HEIGHT); });
+
+    // a frame of a diff eqn trace (points everywhere, fading every frame), and of a poincare
+    // section (a few points a frame, in a band, fading every 8th frame)
+    static AnimRenderer anim(-1, 1, -1, 1);
+    int frame = 0;
+    anim_set_headless_blit(lcd_blit_async, lcd_wait);
+    bench("AnimRenderer::blit/trace", [&]
+    {
+        for (int i = 0; i < 2000; ++i)
+            anim.safePlot((i * 37 + frame) % TinyScopeFrameBuf::IMGW, (i * 101 + frame) % TinyScopeFrameBuf::IMGH);
+        anim.blit();
+        anim.darken();
+        ++frame;
+    });
+    for (int i = 0; i < 16; ++i)
+        anim.darken();
+    anim.blit();
+    bench("AnimRenderer::blit/poincare", [&]
+    {
+        for (int i = 0; i < 20; ++i)
+            anim.safePlot((i * 37 + frame * 11) % TinyScopeFrameBuf::IMGW, 120 + (i * 7 + frame) % 40);
+        anim.blit();
+        if ((++frame & 7) == 0)
+            anim.darken();
+    });
+
+    // whole animations, 16 frames per op, with the frames sent in line or by the worker
+    // (which only gets a thread of its own on a multi-core machine)
+    static const char* const kAnimCmds[] = { "dd", "pd", "ps" };
+    anim_set_headless_frame_limit(16);
+    for (const char* cmd : kAnimCmds)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "anim_%s/serial", cmd);
+        bench(name, [&]{ calc_eval(cmd, resBuf, sizeof(resBuf)); });
+
+        anim_set_pipelined(true);
+        snprintf(name, sizeof(name), "anim_%s/pipelined", cmd);
+        bench(name, [&]{ calc_eval(cmd, resBuf, sizeof(resBuf)); });
+        anim_set_pipelined(false);
+    }
+    anim_set_headless_frame_limit(60);
+
+    anim_set_headless_blit(nullptr, nullptr);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i+1 < argc)
+        {
+            gMinSeconds = atof(argv[++i]) / 1000.0;
+        }
+        else if (argv[i][0] != '-')
+        {
+            gFilter = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "usage: molencalc-bench [-t min_ms_per_bench] [name_filter]\n");
+            return 1;
+        }
+    }
+
+    setup_calc();
+
+    printf("{\n  \"benchmarks\": [");
+
+    bench_calc_eval();
+    bench_parser();
+    bench_lookups();
+    bench_batch();
+    bench_plot();
+    bench_format();
+    bench_font();
+    bench_scope();
+    bench_lcd();
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -16,6 +16,7 @@
 
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "hardware/dma.h"
 #include "hardware/spi.h"
 
 #include "lcd.h"
@@ -33,8 +34,6 @@ static int gCursorX = 0;
 static int gCursorY = 0;
 
 #define MAX_COLS ((WIDTH)/2)
-static int gCurrColIx = 0;
-static uint8_t gColWidths[MAX_COLS];
 
 static uint16_t gFgCol = 0xFF07;
 static uint16_t gBgCol = 0x0000;
@@ -42,15 +41,89 @@ static uint16_t gBgCol = 0x0000;
 // Text drawing
 const Font *font = &font_10x16;
 static uint16_t char_buffer[16 * FONT_MAX_HEIGHT] __attribute__((aligned(4)));
+static uint16_t line_strip[WIDTH * FONT_MAX_HEIGHT] __attribute__((aligned(4)));
+
+// Shadow text grid
+// What was written to each line of text on screen (and for a while after it's scrolled off),
+// as characters rather than pixels. Lines are placed by "content row": the screen row plus
+// how far the display has scrolled, so they stay put as it scrolls
+#define TEXT_LINES (48)
+#define TEXT_ATTRS (16)
+
+typedef struct
+{
+    char Ch;                            // the character, or '\t' for the gap left by a tab
+    uint8_t Attr;                       // index into gTextAttrs
+    uint8_t Width;                      // how far the cursor moved on
+} TextCell;
+
+typedef struct
+{
+    const Font* Font;                   // NULL if the slot's free
+    int32_t Top;                        // content row of the top of the line
+    bool Monospace;
+    bool Wrapped;                       // carries on from the line above
+    uint8_t Len;
+    TextCell Cells[MAX_COLS];
+} TextLine;
+
+static TextLine gTextLines[TEXT_LINES];
+static int gNextTextLine = 0;
+static TextLine* gTextLine = NULL;      // the line last written to
+static bool gTextWrapped = false;       // the cursor's line carries on from the one above
+
+static uint32_t gTextAttrs[TEXT_ATTRS]; // (fg << 16) | bg
+static int gNumTextAttrs = 0;
+static int gTextAttr = -1;              // the current colours' entry, if known
+
+// Content rows the display RAM still holds: the ones on screen, and some either side
+static int32_t gScrollPos = 0;          // content row at the top of the screen
+static int32_t gIntactTop = 0;
+static int32_t gIntactBottom = HEIGHT;
+
+// The window last sent to the controller, as (start << 16) | end
+// Neither is ever 0xFFFF, so that marks them as unknown after a reset or a raw command
+#define LCD_WINDOW_UNKNOWN (0xFFFFFFFFu)
+static uint32_t lcd_window_columns = LCD_WINDOW_UNKNOWN;
+static uint32_t lcd_window_rows = LCD_WINDOW_UNKNOWN;
+static uint32_t lcd_elided_commands = 0;
+
+// Pixel transfers in flight
+static int lcd_dma_channel = -1;
+static volatile bool lcd_dma_pending = false;
 
 // Background processing
 static uint32_t irq_state;
 static repeating_timer_t cursor_timer;
 
+// Finish off the transfer started by lcd_blit_async. Interrupts must be disabled
+static void lcd_end_dma(void)
+{
+    dma_channel_wait_for_finish_blocking(lcd_dma_channel);
+
+    // the DMA is done once the last pixel is in the FIFO, but it still has to be clocked out
+    while (spi_is_busy(LCD_SPI))
+        tight_loop_contents();
+
+    // nothing read the RX FIFO during the transfer, so drain it and clear the overrun
+    while (spi_is_readable(LCD_SPI))
+        (void)spi_get_hw(LCD_SPI)->dr;
+    spi_get_hw(LCD_SPI)->icr = SPI_SSPICR_RORIC_BITS;
+
+    gpio_put(LCD_CSX, 1);
+    spi_set_format(LCD_SPI, 8, 0, 0, SPI_MSB_FIRST);
+
+    lcd_dma_pending = false;
+}
+
 static void lcd_disable_interrupts()
 {
     irq_state = save_and_disable_interrupts();
     //gpio_put(3, true);
+
+    // everything that talks to the LCD comes through here, so it can't trip over an async blit
+    if (lcd_dma_pending)
+        lcd_end_dma();
 }
 
 static void lcd_enable_interrupts()
@@ -70,12 +143,14 @@ void lcd_set_font(const Font *new_font)
 void lcd_set_foreground(uint16_t colour)
 {
     gFgCol = colour;
+    gTextAttr = -1;
 }
 
 // Set background colour
 void lcd_set_background(uint16_t colour)
 {
     gBgCol = colour;
+    gTextAttr = -1;
 }
 
 void lcd_set_monospace(bool mono)
@@ -87,9 +162,18 @@ void lcd_set_monospace(bool mono)
 // Low-level SPI functions
 //
 
+// Forget the window, so the next lcd_set_window sends it all
+static void lcd_window_invalidate(void)
+{
+    lcd_window_columns = LCD_WINDOW_UNKNOWN;
+    lcd_window_rows = LCD_WINDOW_UNKNOWN;
+}
+
 // Send a command
 void lcd_write_cmd(uint8_t cmd)
 {
+    lcd_window_invalidate(); // nothing sent this way goes through the window cache
+
     gpio_put(LCD_DCX, 0); // Command
     gpio_put(LCD_CSX, 0);
     spi_write_blocking(LCD_SPI, &cmd, 1);
@@ -99,17 +183,33 @@ void lcd_write_cmd(uint8_t cmd)
 // Send 8-bit data (byte)
 void lcd_write_data(uint8_t len, ...)
 {
+    uint8_t data[len];
+
     va_list args;
     va_start(args, len);
-    gpio_put(LCD_DCX, 1); // Data
-    gpio_put(LCD_CSX, 0);
     for (uint8_t i = 0; i < len; i++)
     {
-        uint8_t data = va_arg(args, int); // get the next byte of data
-        spi_write_blocking(LCD_SPI, &data, 1);
+        data[i] = va_arg(args, int); // get the next byte of data
     }
-    gpio_put(LCD_CSX, 1);
     va_end(args);
+
+    gpio_put(LCD_DCX, 1); // Data
+    gpio_put(LCD_CSX, 0);
+    spi_write_blocking(LCD_SPI, data, len);
+    gpio_put(LCD_CSX, 1);
+}
+
+// Send a command and its parameters in one go, without raising chip select in between
+// D/CX is only sampled on the last bit of each byte, and spi_write_blocking doesn't return
+// until the command byte is all the way out, so it can be switched over mid-transfer
+static void lcd_write_cmd_params(uint8_t cmd, const uint8_t *params, size_t len)
+{
+    gpio_put(LCD_DCX, 0); // Command
+    gpio_put(LCD_CSX, 0);
+    spi_write_blocking(LCD_SPI, &cmd, 1);
+    gpio_put(LCD_DCX, 1); // Data
+    spi_write_blocking(LCD_SPI, params, len);
+    gpio_put(LCD_CSX, 1);
 }
 
 // Send 16-bit data (half-word)
@@ -156,22 +256,167 @@ void lcd_write16_buf(const uint16_t *buffer, size_t len)
 //
 
 // Select the target of the pixel data in the display RAM that will follow
+// The controller keeps the column and row addresses until they're set again, so only the
+// ones that have changed since the last window are sent. RAMWR is always needed, as that's
+// what moves the write position back to the start of the window
 static void lcd_set_window(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
 {
     // Set column address (X)
-    lcd_write_cmd(LCD_CMD_CASET);
-    lcd_write_data(4,
-                   UPPER8(x0), LOWER8(x0),
-                   UPPER8(x1), LOWER8(x1));
+    const uint32_t columns = ((uint32_t)x0 << 16) | x1;
+    if (columns != lcd_window_columns)
+    {
+        const uint8_t params[4] = {UPPER8(x0), LOWER8(x0), UPPER8(x1), LOWER8(x1)};
+        lcd_write_cmd_params(LCD_CMD_CASET, params, sizeof(params));
+        lcd_window_columns = columns;
+    }
+    else
+    {
+        lcd_elided_commands++;
+    }
 
     // Set row address (Y)
-    lcd_write_cmd(LCD_CMD_RASET);
-    lcd_write_data(4,
-                   UPPER8(y0), LOWER8(y0),
-                   UPPER8(y1), LOWER8(y1));
+    const uint32_t rows = ((uint32_t)y0 << 16) | y1;
+    if (rows != lcd_window_rows)
+    {
+        const uint8_t params[4] = {UPPER8(y0), LOWER8(y0), UPPER8(y1), LOWER8(y1)};
+        lcd_write_cmd_params(LCD_CMD_RASET, params, sizeof(params));
+        lcd_window_rows = rows;
+    }
+    else
+    {
+        lcd_elided_commands++;
+    }
 
     // Prepare to write to RAM
-    lcd_write_cmd(LCD_CMD_RAMWR);
+    lcd_write_cmd_params(LCD_CMD_RAMWR, NULL, 0);
+}
+
+// The number of window commands lcd_set_window hasn't had to send
+uint32_t lcd_get_elided_commands(void)
+{
+    return lcd_elided_commands;
+}
+
+//
+//  Shadow text grid
+//
+//  Every character written is also recorded in gTextLines, which lets backspace step back
+//  over a line wrap, and lets rows that scroll back into view be redrawn from the text rather
+//  than left blank. Anything else drawn over a line of text drops it from the grid.
+//
+
+// Forget all the text, and start the content rows again from the top of the screen
+static void lcd_text_reset()
+{
+    for (int i = 0; i < TEXT_LINES; i++)
+    {
+        gTextLines[i].Font = NULL;
+    }
+    gTextLine = NULL;
+    gTextWrapped = false;
+    gNumTextAttrs = 0;
+    gTextAttr = -1;
+
+    gScrollPos = 0;
+    gIntactTop = 0;
+    gIntactBottom = HEIGHT;
+}
+
+// Drop any lines with pixels in content rows [top, bottom)
+static void lcd_text_forget(int32_t top, int32_t bottom)
+{
+    for (int i = 0; i < TEXT_LINES; i++)
+    {
+        TextLine *line = &gTextLines[i];
+        if (line->Font && line->Top < bottom && line->Top + line->Font->Height > top)
+        {
+            line->Font = NULL;
+        }
+    }
+}
+
+// Find the line of text starting at content row top, in the current font
+static TextLine *lcd_text_find(int32_t top)
+{
+    for (int i = 0; i < TEXT_LINES; i++)
+    {
+        TextLine *line = &gTextLines[i];
+        if (line->Font == font && line->Top == top)
+        {
+            return line;
+        }
+    }
+    return NULL;
+}
+
+// The line the cursor is on, started if it hasn't been written to yet
+static TextLine *lcd_text_line()
+{
+    const int32_t top = gScrollPos + gCursorY;
+    if (gTextLine && gTextLine->Font == font && gTextLine->Top == top)
+    {
+        return gTextLine;
+    }
+
+    // the oldest line makes way, along with whatever the new one is about to be drawn over
+    lcd_text_forget(top, top + font->Height);
+
+    TextLine *line = &gTextLines[gNextTextLine];
+    gNextTextLine = (gNextTextLine + 1) % TEXT_LINES;
+
+    line->Font = font;
+    line->Top = top;
+    line->Monospace = gMonospace;
+    line->Wrapped = gTextWrapped;
+    line->Len = 0;
+
+    gTextLine = line;
+    return line;
+}
+
+// The number of characters between the start of the cursor's line and the cursor
+static int lcd_text_column()
+{
+    const TextLine *line = gTextLine;
+    if (line && line->Font == font && line->Top == gScrollPos + gCursorY)
+    {
+        return line->Len;
+    }
+    return 0;
+}
+
+// The gTextAttrs entry for the current colours
+static uint8_t lcd_text_attr()
+{
+    if (gTextAttr >= 0)
+    {
+        return gTextAttr;
+    }
+
+    const uint32_t colours = ((uint32_t)gFgCol << 16) | gBgCol;
+    for (int i = 0; i < gNumTextAttrs; i++)
+    {
+        if (gTextAttrs[i] == colours)
+        {
+            gTextAttr = i;
+            return gTextAttr;
+        }
+    }
+
+    // out of room, so start again without the text that's already there
+    if (gNumTextAttrs == TEXT_ATTRS)
+    {
+        for (int i = 0; i < TEXT_LINES; i++)
+        {
+            gTextLines[i].Font = NULL;
+        }
+        gTextLine = NULL;
+        gNumTextAttrs = 0;
+    }
+
+    gTextAttrs[gNumTextAttrs] = colours;
+    gTextAttr = gNumTextAttrs++;
+    return gTextAttr;
 }
 
 //
@@ -186,9 +431,8 @@ static void lcd_set_window(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
 //  red component in the upper 5 bits, the green component in the middle 6 bits, and the
 //  blue component in the lower 5 bits.
 
-void lcd_blit(const uint16_t *pixels, int x, int y, int width, int height)
+static void lcd_set_blit_window(int x, int y, int width, int height)
 {
-    lcd_disable_interrupts();
     if (y >= lcd_scroll_top && y < HEIGHT - lcd_scroll_bottom)
     {
         // Adjust y for vertical scroll offset and wrap within memory height
@@ -205,23 +449,315 @@ void lcd_blit(const uint16_t *pixels, int x, int y, int width, int height)
         // No vertical scrolling, use the actual y-coordinate
         lcd_set_window(x, y, x + width - 1, y + height - 1);
     }
+}
 
+static void lcd_draw_pixels(const uint16_t *pixels, int x, int y, int width, int height)
+{
+    lcd_disable_interrupts();
+    lcd_set_blit_window(x, y, width, height);
     lcd_write16_buf((uint16_t *)pixels, width * height);
     lcd_enable_interrupts();
 }
 
+void lcd_blit(const uint16_t *pixels, int x, int y, int width, int height)
+{
+    lcd_text_forget(gScrollPos + y, gScrollPos + y + height);
+    lcd_draw_pixels(pixels, x, y, width, height);
+}
+
+//
+//  Asynchronous pixel transfers
+//
+//  lcd_blit_async hands the pixel data to a DMA channel and returns as soon as the window is
+//  set, so the CPU can get on with preparing the next lot of pixels while these are clocked
+//  out. The SPI bus stays selected until the transfer is finished off by lcd_wait, or by
+//  whatever next disables interrupts to talk to the LCD (including the cursor timer).
+//
+
+void lcd_wait(void)
+{
+    if (!lcd_dma_pending)
+        return;
+
+    lcd_disable_interrupts();
+    lcd_enable_interrupts();
+}
+
+void lcd_blit_async(const uint16_t *pixels, int x, int y, int width, int height)
+{
+    if (lcd_dma_channel < 0)
+    {
+        lcd_blit(pixels, x, y, width, height);
+        return;
+    }
+
+    lcd_text_forget(gScrollPos + y, gScrollPos + y + height);
+
+    lcd_disable_interrupts();
+    lcd_set_blit_window(x, y, width, height);
+
+    // as in lcd_write16_buf, the format change goes before the chip select
+    spi_set_format(LCD_SPI, 16, 0, 0, SPI_MSB_FIRST);
+
+    gpio_put(LCD_DCX, 1); // Data
+    gpio_put(LCD_CSX, 0);
+    dma_channel_transfer_from_buffer_now(lcd_dma_channel, pixels, width * height);
+    lcd_dma_pending = true;
+    lcd_enable_interrupts();
+}
+
+// Pixels can also be streamed into a window a lot at a time, with the chip select held low
+// throughout, so each lot goes out by DMA while the caller prepares the next
+// Interrupts must be disabled from lcd_stream_begin to lcd_stream_end
+static void lcd_stream_begin(void)
+{
+    // as in lcd_write16_buf, the format change goes before the chip select
+    spi_set_format(LCD_SPI, 16, 0, 0, SPI_MSB_FIRST);
+
+    gpio_put(LCD_DCX, 1); // Data
+    gpio_put(LCD_CSX, 0);
+}
+
+// pixels has to stay untouched until the next lcd_stream_pixels or lcd_stream_end
+static void lcd_stream_pixels(const uint16_t *pixels, uint32_t count)
+{
+    if (lcd_dma_channel < 0)
+    {
+        spi_write16_blocking(LCD_SPI, pixels, count);
+        return;
+    }
+
+    if (lcd_dma_pending)
+        dma_channel_wait_for_finish_blocking(lcd_dma_channel);
+
+    dma_channel_transfer_from_buffer_now(lcd_dma_channel, pixels, count);
+    lcd_dma_pending = true;
+}
+
+static void lcd_stream_end(void)
+{
+    if (lcd_dma_pending)
+    {
+        lcd_end_dma();
+        return;
+    }
+
+    gpio_put(LCD_CSX, 1);
+    spi_set_format(LCD_SPI, 8, 0, 0, SPI_MSB_FIRST);
+}
+
+// Set the window for as many rows from y down as fit in one piece of display RAM, which is
+// all of them unless they cross the end of the scrolling area, on screen or in display RAM
+// Returns the number of rows in the window
+static uint16_t lcd_set_split_window(uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    uint16_t rows = height;
+    if (y >= lcd_scroll_top && y < HEIGHT - lcd_scroll_bottom)
+    {
+        uint16_t y_virtual = (lcd_y_offset + y) % lcd_memory_scroll_height;
+        if (rows > HEIGHT - lcd_scroll_bottom - y)
+        {
+            rows = HEIGHT - lcd_scroll_bottom - y;
+        }
+        if (rows > lcd_memory_scroll_height - y_virtual)
+        {
+            rows = lcd_memory_scroll_height - y_virtual;
+        }
+        lcd_set_window(x, lcd_scroll_top + y_virtual, x + width - 1, lcd_scroll_top + y_virtual + rows - 1);
+    }
+    else
+    {
+        lcd_set_window(x, y, x + width - 1, y + rows - 1);
+    }
+
+    return rows;
+}
+
+// Send the same 16-bit value count times, in one go
+static void lcd_write16_fill(uint16_t value, uint32_t count)
+{
+    static uint16_t values[WIDTH];
+
+    const uint32_t chunk = (count < WIDTH) ? count : WIDTH;
+    for (uint32_t i = 0; i < chunk; i++)
+    {
+        values[i] = value;
+    }
+
+    // DO NOT MOVE THE spi_set_format() OR THE gpio_put(LCD_DCX) CALLS!
+    // They are placed before the gpio_put(LCD_CSX) to ensure that a minimum
+    // chip select high pulse width is achieved (at least 40ns)
+    spi_set_format(LCD_SPI, 16, 0, 0, SPI_MSB_FIRST);
+
+    gpio_put(LCD_DCX, 1); // Data
+    gpio_put(LCD_CSX, 0);
+    while (count > 0)
+    {
+        const uint32_t n = (count < chunk) ? count : chunk;
+        spi_write16_blocking(LCD_SPI, values, n);
+        count -= n;
+    }
+    gpio_put(LCD_CSX, 1);
+
+    spi_set_format(LCD_SPI, 8, 0, 0, SPI_MSB_FIRST);
+}
+
+// Fill a rectangle on the display
+// Rows are mapped to display RAM the same way as lcd_blit, but the whole rectangle is sent in
+// one window, or two if it wraps around the bottom of the scrolling area
+static void lcd_fill(uint16_t colour, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
+{
+    if (width == 0)
+    {
+        return;
+    }
+
+    lcd_disable_interrupts();
+    while (height > 0)
+    {
+        const uint16_t rows = lcd_set_split_window(x, y, width, height);
+        lcd_write16_fill(colour, (uint32_t)width * rows);
+
+        y += rows;
+        height -= rows;
+    }
+    lcd_enable_interrupts();
+}
+
 // Draw a solid rectangle on the display
 void lcd_solid_rectangle(uint16_t colour, uint16_t x, uint16_t y, uint16_t width, uint16_t height)
 {
-    static uint16_t pixels[WIDTH];
+    lcd_text_forget(gScrollPos + y, gScrollPos + y + height);
+    lcd_fill(colour, x, y, width, height);
+}
+
+//
+//  Redrawing text from the shadow grid
+//
+
+// Copy a glyph into line_strip at x, clipped to the strip's width
+// returns how far along the strip it went
+static int lcd_strip_glyph(const Font *f, char c, uint16_t fg, uint16_t bg, bool mono, int x, int strip_width)
+{
+    GlyphMetric metric;
+    const uint16_t *src = font_get_glyph(f, c, fg, bg, mono, &metric);
+    const int advance = (metric.Advance < strip_width - x) ? metric.Advance : (strip_width - x);
+
+    uint16_t *dest = line_strip + x;
+    for (int row = 0; row < f->Height; ++row, dest += strip_width, src += metric.Advance)
+        memcpy(dest, src, advance * sizeof(*src));
+
+    return advance;
+}
 
-    for (uint16_t i = 0; i < width; i++)
+// Redraw the part of a line of text that's in content rows [top, bottom), which are on screen,
+// clearing the rest of the width of the screen
+static void lcd_render_line(const TextLine *line, int32_t top, int32_t bottom)
+{
+    const int32_t first = ((top > line->Top) ? top : line->Top) - line->Top;
+    const int32_t last = ((bottom < line->Top + line->Font->Height) ? bottom : line->Top + line->Font->Height) - line->Top;
+    if (first >= last)
     {
-        pixels[i] = colour;
+        return;
     }
-    for (uint16_t row = 0; row < height; row++)
+
+    int strip_width = 0;
+    for (int i = 0; i < line->Len; i++)
+    {
+        strip_width += line->Cells[i].Width;
+    }
+    if (strip_width > WIDTH)
     {
-        lcd_blit(pixels, x, y + row, width, 1);
+        strip_width = WIDTH;
+    }
+
+    int x = 0;
+    for (int i = 0; i < line->Len && x < strip_width; i++)
+    {
+        const TextCell *cell = &line->Cells[i];
+        const uint16_t fg = gTextAttrs[cell->Attr] >> 16;
+        const uint16_t bg = gTextAttrs[cell->Attr] & 0xFFFF;
+        if (cell->Ch == '\t')
+        {
+            const int gap = (cell->Width < strip_width - x) ? cell->Width : (strip_width - x);
+            for (int row = 0; row < line->Font->Height; row++)
+            {
+                for (int col = 0; col < gap; col++)
+                    line_strip[(row * strip_width) + x + col] = bg;
+            }
+            x += gap;
+        }
+        else
+        {
+            x += lcd_strip_glyph(line->Font, cell->Ch, fg, bg, line->Monospace, x, strip_width);
+        }
+    }
+
+    const int y = line->Top + first - gScrollPos;
+    if (strip_width > 0)
+    {
+        lcd_draw_pixels(line_strip + (first * strip_width), 0, y, strip_width, last - first);
+    }
+    lcd_fill(gBgCol, strip_width, y, WIDTH - strip_width, last - first);
+}
+
+// Content rows [top, bottom) have just come into view, so make sure display RAM has them
+// Any rows it still holds are left alone, and the rest are cleared and have their text redrawn
+static void lcd_restore_rows(int32_t top, int32_t bottom)
+{
+    if (top >= gIntactTop && bottom <= gIntactBottom)
+    {
+        return;
+    }
+    if (top >= gIntactTop && top < gIntactBottom)
+    {
+        top = gIntactBottom;
+    }
+    if (bottom > gIntactTop && bottom <= gIntactBottom)
+    {
+        bottom = gIntactTop;
+    }
+
+    // work down the rows a line at a time, clearing the gaps in between
+    for (int32_t row = top; row < bottom; )
+    {
+        const TextLine *next = NULL;
+        for (int i = 0; i < TEXT_LINES; i++)
+        {
+            const TextLine *line = &gTextLines[i];
+            if (line->Font && line->Top < bottom && line->Top + line->Font->Height > row &&
+                (!next || line->Top < next->Top))
+            {
+                next = line;
+            }
+        }
+
+        const int32_t gap_end = !next ? bottom : (next->Top > row) ? next->Top : row;
+        lcd_fill(gBgCol, 0, row - gScrollPos, WIDTH, gap_end - row);
+        if (!next)
+            break;
+
+        lcd_render_line(next, row, bottom);
+        row = next->Top + next->Font->Height;
+    }
+
+    // display RAM wraps around, so what's drawn at one end is lost from the other
+    if (top == gIntactBottom)
+    {
+        gIntactBottom = bottom;
+        if (gIntactTop < bottom - lcd_memory_scroll_height)
+            gIntactTop = bottom - lcd_memory_scroll_height;
+    }
+    else if (bottom == gIntactTop)
+    {
+        gIntactTop = top;
+        if (gIntactBottom > top + lcd_memory_scroll_height)
+            gIntactBottom = top + lcd_memory_scroll_height;
+    }
+    else
+    {
+        gIntactTop = top;
+        gIntactBottom = bottom;
     }
 }
 
@@ -236,6 +772,13 @@ void lcd_solid_rectangle(uint16_t colour, uint16_t x, uint16_t y, uint16_t width
 //  to ensure that the pixel data is written to the correct location in the display RAM.
 //
 
+// Send the scroll start address (VSCSAD)
+static void lcd_set_scroll_start(uint16_t scroll_area_start)
+{
+    const uint8_t params[2] = {UPPER8(scroll_area_start), LOWER8(scroll_area_start)};
+    lcd_write_cmd_params(LCD_CMD_VSCSAD, params, sizeof(params));
+}
+
 void lcd_define_scrolling(uint16_t top_fixed_area, uint16_t bottom_fixed_area)
 {
     uint16_t scroll_area = HEIGHT - (top_fixed_area + bottom_fixed_area);
@@ -252,14 +795,10 @@ void lcd_define_scrolling(uint16_t top_fixed_area, uint16_t bottom_fixed_area)
     lcd_scroll_bottom = bottom_fixed_area;
 
     lcd_disable_interrupts();
-    lcd_write_cmd(LCD_CMD_VSCRDEF);
-    lcd_write_data(6,
-                   UPPER8(lcd_scroll_top),
-                   LOWER8(lcd_scroll_top),
-                   UPPER8(scroll_area),
-                   LOWER8(scroll_area),
-                   UPPER8(lcd_scroll_bottom),
-                   LOWER8(lcd_scroll_bottom));
+    const uint8_t params[6] = {UPPER8(lcd_scroll_top), LOWER8(lcd_scroll_top),
+                               UPPER8(scroll_area), LOWER8(scroll_area),
+                               UPPER8(lcd_scroll_bottom), LOWER8(lcd_scroll_bottom)};
+    lcd_write_cmd_params(LCD_CMD_VSCRDEF, params, sizeof(params));
     lcd_enable_interrupts();
 
     lcd_scroll_reset(); // Reset the scroll area to the top
@@ -270,10 +809,10 @@ void lcd_scroll_reset()
     // Clear the scrolling area by filling it with the background colour
     lcd_y_offset = 0; // Reset the scroll offset
     uint16_t scroll_area_start = lcd_scroll_top + lcd_y_offset;
+    lcd_text_reset(); // What's on screen no longer lines up with the shadow grid
 
     lcd_disable_interrupts();
-    lcd_write_cmd(LCD_CMD_VSCSAD); // Sets where in display RAM the scroll area starts
-    lcd_write_data(2, UPPER8(scroll_area_start), LOWER8(scroll_area_start));
+    lcd_set_scroll_start(scroll_area_start); // Sets where in display RAM the scroll area starts
     lcd_enable_interrupts();
 }
 
@@ -282,7 +821,8 @@ void lcd_scroll_clear()
     lcd_scroll_reset(); // Reset the scroll area to the top
 
     // Clear the scrolling area
-    lcd_solid_rectangle(gBgCol, 0, lcd_scroll_top, WIDTH, lcd_memory_scroll_height);
+    lcd_fill(gBgCol, 0, lcd_scroll_top, WIDTH, lcd_memory_scroll_height);
+    gIntactTop = HEIGHT - lcd_memory_scroll_height;
 }
 
 // Scroll the screen up one line (make space at the bottom)
@@ -294,15 +834,15 @@ void lcd_scroll_up(uint32_t distance)
     }
     // This will rotate the content in the scroll area up by one line
     lcd_y_offset = (lcd_y_offset + distance) % lcd_memory_scroll_height;
+    gScrollPos += distance;
     uint16_t scroll_area_start = lcd_scroll_top + lcd_y_offset;
 
     lcd_disable_interrupts();
-    lcd_write_cmd(LCD_CMD_VSCSAD); // Sets where in display RAM the scroll area starts
-    lcd_write_data(2, UPPER8(scroll_area_start), LOWER8(scroll_area_start));
+    lcd_set_scroll_start(scroll_area_start); // Sets where in display RAM the scroll area starts
     lcd_enable_interrupts();
 
-    // Clear the new line at the bottom
-    lcd_solid_rectangle(gBgCol, 0, HEIGHT - distance, WIDTH, distance);
+    // Clear the new line at the bottom, unless it's still there from before a scroll down
+    lcd_restore_rows(gScrollPos + HEIGHT - distance, gScrollPos + HEIGHT);
 
     if (gCursorY > distance)
         gCursorY -= distance;
@@ -321,15 +861,15 @@ void lcd_scroll_down()
     }
     // This will rotate the content in the scroll area down by one line
     lcd_y_offset = (lcd_y_offset - glyph_height + lcd_memory_scroll_height) % lcd_memory_scroll_height;
+    gScrollPos -= glyph_height;
     uint16_t scroll_area_start = lcd_scroll_top + lcd_y_offset;
 
     lcd_disable_interrupts();
-    lcd_write_cmd(LCD_CMD_VSCSAD); // Sets where in display RAM the scroll area starts
-    lcd_write_data(2, UPPER8(scroll_area_start), LOWER8(scroll_area_start));
+    lcd_set_scroll_start(scroll_area_start); // Sets where in display RAM the scroll area starts
     lcd_enable_interrupts();
 
-    // Clear the new line at the top
-    lcd_solid_rectangle(gBgCol, 0, lcd_scroll_top, WIDTH, glyph_height);
+    // Bring back the line at the top, from display RAM if it's still there or the shadow grid if not
+    lcd_restore_rows(gScrollPos + lcd_scroll_top, gScrollPos + lcd_scroll_top + glyph_height);
 }
 
 //
@@ -340,7 +880,8 @@ void lcd_scroll_down()
 void lcd_clear_screen()
 {
     lcd_scroll_reset(); // Reset the scrolling area to the top
-    lcd_solid_rectangle(gBgCol, 0, 0, WIDTH, FRAME_HEIGHT);
+    lcd_fill(gBgCol, 0, 0, WIDTH, FRAME_HEIGHT);
+    gIntactTop = HEIGHT - lcd_memory_scroll_height;
 }
 
 
@@ -378,34 +919,47 @@ void lcd_inc_column(uint8_t advance)
 {
     gCursorX += advance;
 
-    gColWidths[gCurrColIx] = advance;
-    ++gCurrColIx;
-
-    if (gCursorX >= WIDTH || gCurrColIx >= MAX_COLS)
+    if (gCursorX >= WIDTH || lcd_text_column() >= MAX_COLS)
     {
         gCursorX = 0;
         gCursorY += font->Height;
-
-        // TODO: this breaks backspace from one line to the previous
-        // ideally we'd remember the start ix of each line and only reset when flushing
-        gCurrColIx = 0;
+        gTextWrapped = true;
     }
 }
 
-void lcd_backspace()
+// Step back over the last character, without touching the cursor
+// If the cursor's at the start of a line that wrapped, that's the last character on the line above
+static void lcd_move_back()
 {
-    if (gCurrColIx <= 0)
-        return;
-
-    lcd_erase_cursor();
+    TextLine *line = lcd_text_find(gScrollPos + gCursorY);
+    if (!line || line->Len == 0)
+    {
+        const bool wrapped = line ? line->Wrapped : gTextWrapped;
+        TextLine *above = lcd_text_find(gScrollPos + gCursorY - font->Height);
+        if (!wrapped || !above || above->Len == 0 || gCursorY < font->Height)
+            return;
 
-    --gCurrColIx;
+        gCursorX = 0;
+        for (int i = 0; i < above->Len; i++)
+        {
+            gCursorX += above->Cells[i].Width;
+        }
+        gCursorY -= font->Height;
+        gTextWrapped = false;
+        gTextLine = above;
+        line = above;
+    }
 
-    const int glyphWidth = gColWidths[gCurrColIx];
+    const int glyphWidth = line->Cells[--line->Len].Width;
     gCursorX -= glyphWidth;
 
-    lcd_solid_rectangle(gBgCol, gCursorX, gCursorY, glyphWidth, font->Height);
+    lcd_fill(gBgCol, gCursorX, gCursorY, (gCursorX + glyphWidth > WIDTH) ? WIDTH - gCursorX : glyphWidth, font->Height);
+}
 
+void lcd_backspace()
+{
+    lcd_erase_cursor();
+    lcd_move_back();
     lcd_draw_cursor();
 }
 
@@ -414,6 +968,7 @@ static void lcd_next_line()
 {
     const int glyph_height = font->Height;
     gCursorY += glyph_height;
+    gTextWrapped = false;
 
     while (gCursorY >= (HEIGHT - glyph_height))
         lcd_scroll_up(glyph_height);
@@ -422,29 +977,79 @@ static void lcd_next_line()
 static void lcd_next_tab()
 {
     const int tabwidth = 6 * font->Width;
+    const int x0 = gCursorX;
     gCursorX += tabwidth + font->Width - 1;
     if (gCursorX >= (WIDTH - tabwidth))
     {
         gCursorX = 0;
-        gCurrColIx = 0;
         lcd_next_line();
     }
     else
     {
         gCursorX -= (gCursorX % tabwidth);
+
+        // the gap goes in the grid too, so backspace can step back over it
+        TextLine *line = lcd_text_line();
+        if (line->Len < MAX_COLS)
+        {
+            line->Cells[line->Len++] = (TextCell){'\t', lcd_text_attr(), gCursorX - x0};
+        }
     }
 }
 
 
 
-void lcd_emit(char c)
+static bool is_printable(char c)
+{
+    return (c >= 0x20 && c < 0x7F);
+}
+
+// Lays out a run of printable characters from the cursor into one strip, and sends the lot in
+// a single window. The run stops at the first non-printable character or where the line wraps
+// returns how many characters were drawn
+static size_t lcd_emit_run(const char* s, size_t len)
 {
-    lcd_erase_cursor(); // erase the cursor before processing the character
+    const int glyph_height = font->Height;
+    const int x0 = gCursorX;
+    const int y0 = gCursorY;
+    const uint8_t attr = lcd_text_attr();
+    TextLine *line = lcd_text_line();
+
+    // find the end of the run, the same way lcd_inc_column will wrap it
+    size_t n = 0;
+    int run_width = 0;
+    for (int col = line->Len; n < len && is_printable(s[n]); )
+    {
+        run_width += font_get_glyph_metric(font, s[n], gMonospace).Advance;
+        ++n;
+        ++col;
+        if (x0 + run_width >= WIDTH || col >= MAX_COLS)
+            break;
+    }
+    if (x0 + run_width > WIDTH)
+        run_width = WIDTH - x0;
 
+    // copy each glyph in from the glyph cache, and note it in the grid
+    int x = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        x += lcd_strip_glyph(font, s[i], gFgCol, gBgCol, gMonospace, x, run_width);
+
+        const uint8_t advance = font_get_glyph_metric(font, s[i], gMonospace).Advance;
+        line->Cells[line->Len++] = (TextCell){s[i], attr, advance};
+        lcd_inc_column(advance);
+    }
+
+    lcd_draw_pixels(line_strip, x0, y0, run_width, glyph_height);
+    return n;
+}
+
+static void lcd_emit_control(char c)
+{
     switch (c)
     {
     case CHR_BS:
-        lcd_backspace();
+        lcd_move_back();
         break;
 
     case '\t':
@@ -452,71 +1057,186 @@ void lcd_emit(char c)
         break;
 
     case '\n':
-        gCurrColIx = 0;
         gCursorX = 0;
         lcd_next_line();
+        break;
+    }
+}
+
+// Printable characters are drawn a run at a time, and the cursor only moves once at the end
+void lcd_emit_chars(const char* s, size_t len)
+{
+    lcd_erase_cursor(); // erase the cursor before processing the characters
 
-    default:
-        if (c >= 0x20 && c < 0x7F) // printable characters
+    for (size_t i = 0; i < len; )
+    {
+        if (is_printable(s[i]))
         {
-            const uint8_t advance = lcd_putc(gCursorX, gCursorY, c);
-            lcd_inc_column(advance);
+            i += lcd_emit_run(s + i, len - i);
+        }
+        else
+        {
+            lcd_emit_control(s[i]);
+            ++i;
         }
-        break;
     }
 
     lcd_draw_cursor();
 }
 
+void lcd_emit(char c)
+{
+    lcd_emit_chars(&c, 1);
+}
+
 void lcd_emit_str(const char* s)
 {
     if (!s)
         return;
-    
-    for (; *s; ++s)
-        lcd_emit(*s);
+
+    lcd_emit_chars(s, strlen(s));
 }
 
 
-void lcd_put_image(const uint16_t* pixels, uint32_t imgw, uint32_t imgh) 
+// images sit one pixel in from the right, unless they're the full width of the screen
+static int image_left(uint32_t imgw)
+{
+    int img_left = (int)(WIDTH - imgw - 1);
+    if (img_left < 0)
+        img_left = 0;
+    return img_left;
+}
+
+// scroll up if needed and draw one line of an image below the last one
+static void put_image_line(const uint16_t* line, uint32_t imgw)
+{
+    const uint32_t line_height = 1;
+
+    // scroll up enough so there's at least a line's worth of pixels free to draw on 
+    // nb. we're over-clearing the back buf at this point as we're about to blat over a chunk with the img 
+    int line_btm = gCursorY; 
+    int img_top = HEIGHT - line_height; 
+    if (line_btm > img_top) 
+    { 
+        lcd_scroll_up(line_btm - img_top); 
+        line_btm = gCursorY; 
+    }
+    if (img_top > line_btm)
+        img_top = line_btm;
+
+    lcd_blit_async(line, image_left(imgw), img_top, imgw, line_height);
+
+    gCursorY += line_height;
+}
+
+// whether an image fits in the scrolling area, so it can be sent in one go
+static bool image_fits(uint32_t imgw, uint32_t imgh)
+{
+    return (imgw <= WIDTH && imgh <= (uint32_t)(HEIGHT - lcd_scroll_top - lcd_scroll_bottom));
+}
+
+// scroll once to make room for the whole image below the last line, and return where it goes
+static uint16_t image_make_room(uint32_t imgh)
 {
     lcd_erase_cursor();
 
-    // we draw the image line-by-line
-    // partly because it makes it animate nice, and partly because 
-    // figuring out the appropriate logic to wrap the image around the frame
-    // is more effort than i'm interested in :)
-    uint32_t height_remaining = imgh;
-
-    const uint16_t* next_pixels = pixels;
-    while (height_remaining > 0)
-    {
-        uint32_t line_height = 1;
-
-        // scroll up enough so there's at least imgh pixels free to draw on 
-        // nb. we're over-clearing the back buf at this point as we're about to blat over a chunk with the img 
-        int line_btm = gCursorY; 
-        int img_top = HEIGHT - line_height; 
-        if (line_btm > img_top) 
-        { 
-            lcd_scroll_up(line_btm - img_top); 
-            line_btm = gCursorY; 
-        }
-        if (img_top > line_btm)
-            img_top = line_btm;
+    if (gCursorY + imgh > HEIGHT)
+        lcd_scroll_up(gCursorY + imgh - HEIGHT);
 
-        const int img_left = (int)(WIDTH - imgw - 1);
+    lcd_text_forget(gScrollPos + gCursorY, gScrollPos + gCursorY + imgh);
+    return gCursorY;
+}
 
-        lcd_blit(next_pixels, img_left, img_top, imgw, line_height);
-    
-        gCursorY += line_height;
-        height_remaining -= line_height;
-        next_pixels += imgw * line_height;
+void lcd_put_image(const uint16_t* pixels, uint32_t imgw, uint32_t imgh) 
+{
+    // too tall to be on screen all at once, so let it scroll past
+    if (!image_fits(imgw, imgh))
+    {
+        lcd_put_image_reveal(pixels, imgw, imgh);
+        return;
+    }
+
+    // send it in as few windows as the display RAM allows: two if it wraps around the end of
+    // the scrolling area, otherwise one
+    const int img_left = image_left(imgw);
+    uint16_t y = image_make_room(imgh);
+    uint32_t rows_left = imgh;
+    lcd_disable_interrupts();
+    while (rows_left > 0)
+    {
+        const uint16_t rows = lcd_set_split_window(img_left, y, imgw, rows_left);
+        lcd_write16_buf(pixels, imgw * rows);
+        pixels += imgw * rows;
+        y += rows;
+        rows_left -= rows;
     }
+    lcd_enable_interrupts();
+
+    gCursorY += imgh;
+
+    // note: leave the cursor undrawn here as it can interfere with the next line of text
+    //lcd_draw_cursor();
+} 
+
+void lcd_put_image_reveal(const uint16_t* pixels, uint32_t imgw, uint32_t imgh) 
+{
+    lcd_erase_cursor();
+
+    // we draw the image line-by-line
+    // partly because it makes it animate nice, and partly because it copes with images
+    // taller than the screen
+    for (uint32_t y = 0; y < imgh; ++y)
+        put_image_line(pixels + (y * imgw), imgw);
+    lcd_wait();
 
     // note: leave the cursor undrawn here as it can interfere with the next line of text
     //lcd_draw_cursor();
 } 
+
+void lcd_put_image_rows(const void* image, lcd_image_row_func get_row, uint32_t imgw, uint32_t imgh)
+{
+    if (imgw > WIDTH)
+        return;
+
+    // each line is expanded while the one before it is still being sent
+    static uint16_t lines[2][WIDTH];
+
+    // too tall to be on screen all at once, so let it scroll past a line at a time
+    if (!image_fits(imgw, imgh))
+    {
+        lcd_erase_cursor();
+        for (uint32_t y = 0; y < imgh; ++y)
+        {
+            uint16_t* line = lines[y & 1];
+            get_row(image, y, line);
+            put_image_line(line, imgw);
+        }
+        lcd_wait();
+        return;
+    }
+
+    // otherwise, as lcd_put_image, with the lines streamed into one window, or two
+    const int img_left = image_left(imgw);
+    uint16_t y = image_make_room(imgh);
+    uint32_t img_y = 0;
+    lcd_disable_interrupts();
+    while (img_y < imgh)
+    {
+        const uint16_t rows = lcd_set_split_window(img_left, y, imgw, imgh - img_y);
+        lcd_stream_begin();
+        for (uint16_t i = 0; i < rows; ++i, ++img_y)
+        {
+            uint16_t* line = lines[img_y & 1];
+            get_row(image, img_y, line);
+            lcd_stream_pixels(line, imgw);
+        }
+        lcd_stream_end();
+        y += rows;
+    }
+    lcd_enable_interrupts();
+
+    gCursorY += imgh;
+}
  
 
 
@@ -553,7 +1273,7 @@ static void blit_cursor(uint16_t col)
     if (!cursor_enabled)
         return;
 
-    lcd_solid_rectangle(col, gCursorX, gCursorY + font->Height - 1, font->Width, 1);
+    lcd_fill(col, gCursorX, gCursorY + font->Height - 1, font->Width, 1);
 }
 
 // Draw the cursor at the current position
@@ -581,6 +1301,8 @@ void lcd_reset()
 
     gpio_put(LCD_RST, 1);
     busy_wait_us(120000); // 5ms required after reset, but 120ms needed before sleep out command
+
+    lcd_window_invalidate(); // the controller is back to its default window
 }
 
 // Turn on the LCD display
@@ -656,6 +1378,15 @@ void lcd_init()
     gpio_set_function(LCD_SDI, GPIO_FUNC_SPI);
     gpio_set_function(LCD_SDO, GPIO_FUNC_SPI);
 
+    // a DMA channel to feed pixels to the SPI TX FIFO, half a word at a time
+    lcd_dma_channel = dma_claim_unused_channel(true);
+    dma_channel_config dma_config = dma_channel_get_default_config(lcd_dma_channel);
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_16);
+    channel_config_set_dreq(&dma_config, spi_get_dreq(LCD_SPI, true));
+    channel_config_set_read_increment(&dma_config, true);
+    channel_config_set_write_increment(&dma_config, false);
+    dma_channel_configure(lcd_dma_channel, &dma_config, &spi_get_hw(LCD_SPI)->dr, NULL, 0, false);
+
     gpio_put(LCD_CSX, 1);
     gpio_put(LCD_RST, 1);
 
@@ -105,8 +105,15 @@ void lcd_write_data(uint8_t len, ...);
 void lcd_write16_data(uint8_t len, ...);
 void lcd_write16_buf(const uint16_t *buffer, size_t len);
 
+// How many CASET/RASET commands have been skipped because the window hadn't changed
+uint32_t lcd_get_elided_commands(void);
+
 // Display window and drawing functions
+// lcd_blit_async returns while the pixels are still being sent, so they must be left alone
+// until lcd_wait (or the next call into the driver that talks to the LCD)
 void lcd_blit(const uint16_t *pixels, int x, int y, int width, int height);
+void lcd_blit_async(const uint16_t *pixels, int x, int y, int width, int height);
+void lcd_wait(void);
 void lcd_solid_rectangle(uint16_t colour, uint16_t x, uint16_t y, uint16_t width, uint16_t height);
 
 // Scrolling functions
@@ -127,7 +134,16 @@ void lcd_backspace();
 
 void lcd_emit(char c);
 void lcd_emit_str(const char* s);
+void lcd_emit_chars(const char* s, size_t len);
+// lcd_put_image scrolls once to make room and sends the whole image in one go, where
+// lcd_put_image_reveal draws it a line at a time, scrolling as it goes
 void lcd_put_image(const uint16_t* pixels, uint32_t imgw, uint32_t imgh);
+void lcd_put_image_reveal(const uint16_t* pixels, uint32_t imgw, uint32_t imgh);
+
+// like lcd_put_image, for images that aren't stored as RGB565: get_row fills in row y of
+// image one line at a time, so only a line's worth of pixels is ever expanded
+typedef void (*lcd_image_row_func)(const void* image, uint32_t y, uint16_t* row);
+void lcd_put_image_rows(const void* image, lcd_image_row_func get_row, uint32_t imgw, uint32_t imgh);
 
 void lcd_move_cursor(uint8_t x, uint8_t y);
 void lcd_draw_cursor(void);
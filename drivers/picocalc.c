@@ -13,10 +13,7 @@ static void *chars_available_param = NULL;
 
 static void picocalc_out_chars(const char *buf, int length)
 {
-    for (int i = 0; i < length; ++i)
-    {
-        lcd_emit(buf[i]);
-    }
+    lcd_emit_chars(buf, length);
 }
 
 static void picocalc_out_flush(void)
@@ -0,0 +1,229 @@
+//
+//  molencalc-cli
+//
+//  A headless molencalc for the host: reads one expression per line from stdin, prints the
+//  results to stdout and writes any graphs out as .ppm images.
+//
+//  With -s, everything is also drawn through the real LCD driver onto a simulated LCD (see
+//  lcdsim.h): the SPI traffic for each line goes to stderr, and what's on the screen at the
+//  end is written to screen_ppm. -a runs animations pipelined, with each frame sent from a
+//  second thread while the next one is worked out, as they are on the pico. -t sizes animation
+//  frames to the frame rate, as the pico does, rather than running a fixed number of steps a
+//  frame (the "as" command shows how that went).
+//
+//  usage: molencalc-cli [-p plot_prefix] [-f anim_frames] [-a] [-t] [-s screen_ppm]
+//
+
+#include "drivers/lcd.h"
+#include "host/lcdsim.h"
+#include "libcalc/animrender.h"
+#include "libcalc/libcalc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+//-------------------------------------------------------------------------------------------------
+
+static void cli_puts(const char* str)
+{
+    fputs(str, stdout);
+}
+
+static void cli_lcd_puts(const char* str)
+{
+    fputs(str, stdout);
+    lcd_emit_str(str);
+}
+
+static void get_plot_lcd_row(const void* plot, uint32_t y, uint16_t* row)
+{
+    get_plot_row((const Plot*)plot, int(y), row);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// get_row fills in row y of the image as RGB565
+template<typename GetRowFn>
+static bool write_ppm(const char* path, int width, int height, GetRowFn get_row)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    fprintf(f, "P6\n%d %d\n255\n", width, height);
+
+    uint16_t row[WIDTH > MC_PLOT_WIDTH ? WIDTH : MC_PLOT_WIDTH];
+    for (int y = 0; y < height; ++y)
+    {
+        get_row(y, row);
+
+        for (const uint16_t* pix = row; pix != row + width; ++pix)
+        {
+            // expand RGB565 to RGB888, replicating the top bits into the bottom
+            const uint8_t r = (*pix >> 11) & 0x1f;
+            const uint8_t g = (*pix >> 5) & 0x3f;
+            const uint8_t b = *pix & 0x1f;
+
+            const uint8_t rgb[3] =
+            {
+                uint8_t((r << 3) | (r >> 2)),
+                uint8_t((g << 2) | (g >> 4)),
+                uint8_t((b << 3) | (b >> 2)),
+            };
+            fwrite(rgb, 1, sizeof(rgb), f);
+        }
+    }
+
+    return (fclose(f) == 0);
+}
+
+static void print_lcd_stats()
+{
+    // the driver's count never resets, so report how far it's moved on since last time
+    static uint32_t lastElided = 0;
+    const uint32_t elided = lcd_get_elided_commands();
+
+    const LcdSimStats& stats = lcdsim_stats();
+    fprintf(stderr, "  (lcd: %u commands, %u command bytes, %u data bytes, %u windows, %u pixels, %u elided)\n",
+        unsigned(stats.Commands), unsigned(stats.CmdBytes), unsigned(stats.DataBytes),
+        unsigned(stats.WindowSets), unsigned(stats.Pixels), unsigned(elided - lastElided));
+    lcdsim_reset_stats();
+    lastElided = elided;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void usage()
+{
+    fprintf(stderr, "usage: molencalc-cli [-p plot_prefix] [-f anim_frames] [-a] [-t] [-s screen_ppm]\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* plotPrefix = "plot";
+    const char* screenPath = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-p") == 0 && i+1 < argc)
+        {
+            plotPrefix = argv[++i];
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i+1 < argc)
+        {
+            anim_set_headless_frame_limit(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "-a") == 0)
+        {
+            anim_set_pipelined(true);
+        }
+        else if (strcmp(argv[i], "-t") == 0)
+        {
+            anim_set_scheduled(true);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i+1 < argc)
+        {
+            screenPath = argv[++i];
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    const bool interactive = isatty(fileno(stdin));
+
+    char inputBuf[256];
+    char outputBuf[512];
+
+    if (screenPath)
+    {
+        lcdsim_attach();
+        lcd_init();
+        anim_set_headless_blit(lcd_blit_async, lcd_wait);
+
+        calc_init(cli_lcd_puts);
+        lcd_emit_str(MCALC_WELCOME);
+        print_lcd_stats();
+    }
+    else
+    {
+        calc_init(cli_puts);
+    }
+
+    if (interactive)
+        printf(MCALC_WELCOME);
+
+    int numPlots = 0;
+    bool allOk = true;
+
+    for (;;)
+    {
+        if (interactive)
+        {
+            printf("\n>");
+            fflush(stdout);
+        }
+
+        if (!fgets(inputBuf, sizeof(inputBuf), stdin))
+            break;
+
+        inputBuf[strcspn(inputBuf, "\r\n")] = 0;
+        if (strlen(inputBuf) == 0)
+            continue; // Skip empty input
+
+        reset_plot();
+
+        // echo the line as it would have been typed in
+        if (screenPath)
+        {
+            lcd_emit_str("\n>");
+            lcd_emit_str(inputBuf);
+            lcd_emit_str("\n");
+            lcd_erase_cursor();
+        }
+
+        if (!calc_eval(inputBuf, outputBuf, sizeof(outputBuf)))
+            allOk = false;
+        puts(outputBuf);
+
+        if (screenPath)
+        {
+            lcd_emit_str(outputBuf);
+            lcd_emit_str("\n");
+        }
+
+        const Plot* plot = get_plot();
+        if (plot && screenPath)
+            lcd_put_image_rows(plot, get_plot_lcd_row, MC_PLOT_WIDTH, MC_PLOT_HEIGHT);
+
+        if (screenPath)
+            print_lcd_stats();
+
+        if (plot)
+        {
+            char path[256];
+            snprintf(path, sizeof(path), "%s%d.ppm", plotPrefix, numPlots++);
+
+            if (write_ppm(path, MC_PLOT_WIDTH, MC_PLOT_HEIGHT, [plot](int y, uint16_t* row){ get_plot_row(plot, y, row); }))
+                fprintf(stderr, "  (wrote %s, %u evals, %u interval evals)\n", path,
+                    unsigned(plot->NumEvals), unsigned(plot->NumIntervalEvals));
+            else
+                fprintf(stderr, "  (couldn't write %s)\n", path);
+        }
+    }
+
+    if (screenPath && !write_ppm(screenPath, WIDTH, HEIGHT, lcdsim_get_screen_row))
+    {
+        fprintf(stderr, "couldn't write %s\n", screenPath);
+        allOk = false;
+    }
+
+    return allOk ? 0 : 2;
+}
+
+//-------------------------------------------------------------------------------------------------
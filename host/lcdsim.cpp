@@ -0,0 +1,221 @@
+#include "lcdsim.h"
+
+#include "drivers/lcd.h"
+#include "pico_stub.h"
+
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+static uint16_t gFrameMem[FRAME_HEIGHT][WIDTH];
+
+static LcdSimStats gStats;
+
+static bool gChipSelected = false;
+static bool gDataMode = false;
+
+// the command being received, and how many parameter bytes it's had
+static uint8_t gCmd = LCD_CMD_NOP;
+static int gNumParams = 0;
+static uint8_t gParams[6];
+
+// the RAMWR window, and where the next pixel goes in it
+static int gWinX0 = 0, gWinX1 = WIDTH - 1;
+static int gWinY0 = 0, gWinY1 = FRAME_HEIGHT - 1;
+static int gColX0 = 0, gColX1 = WIDTH - 1;      // last CASET/RASET, applied at the next RAMWR
+static int gRowY0 = 0, gRowY1 = FRAME_HEIGHT - 1;
+static int gPixX = 0, gPixY = 0;
+
+// pixels arrive a byte at a time in 8-bit mode
+static bool gHavePixelByte = false;
+static uint8_t gPixelByte = 0;
+
+// vertical scrolling
+static int gTopFixed = 0;
+static int gBottomFixed = 0;
+static int gScrollStart = 0;
+
+//-------------------------------------------------------------------------------------------------
+
+static void put_pixel(uint16_t col)
+{
+    if (gPixX < WIDTH && gPixY < FRAME_HEIGHT)
+        gFrameMem[gPixY][gPixX] = col;
+    ++gStats.Pixels;
+
+    if (++gPixX > gWinX1)
+    {
+        gPixX = gWinX0;
+        if (++gPixY > gWinY1)
+            gPixY = gWinY0;
+    }
+}
+
+static void begin_cmd(uint8_t cmd)
+{
+    gCmd = cmd;
+    gNumParams = 0;
+    gHavePixelByte = false;
+
+    ++gStats.Commands;
+
+    if (cmd == LCD_CMD_RAMWR)
+    {
+        gWinX0 = gColX0;
+        gWinX1 = gColX1;
+        gWinY0 = gRowY0;
+        gWinY1 = gRowY1;
+        gPixX = gWinX0;
+        gPixY = gWinY0;
+        ++gStats.WindowSets;
+    }
+}
+
+static inline int param16(int ix)
+{
+    return (gParams[ix] << 8) | gParams[ix + 1];
+}
+
+static void data_byte(uint8_t byte)
+{
+    if (gCmd == LCD_CMD_RAMWR)
+    {
+        if (gHavePixelByte)
+            put_pixel(uint16_t((gPixelByte << 8) | byte));
+        else
+            gPixelByte = byte;
+        gHavePixelByte = !gHavePixelByte;
+        return;
+    }
+
+    if (gNumParams >= int(sizeof(gParams)))
+        return;
+    gParams[gNumParams++] = byte;
+
+    switch (gCmd)
+    {
+    case LCD_CMD_CASET:
+        if (gNumParams == 4)
+        {
+            gColX0 = param16(0);
+            gColX1 = param16(2);
+        }
+        break;
+
+    case LCD_CMD_RASET:
+        if (gNumParams == 4)
+        {
+            gRowY0 = param16(0);
+            gRowY1 = param16(2);
+        }
+        break;
+
+    case LCD_CMD_VSCRDEF:
+        if (gNumParams == 6)
+        {
+            gTopFixed = param16(0);
+            gBottomFixed = param16(4);
+        }
+        break;
+
+    case LCD_CMD_VSCSAD:
+        if (gNumParams == 2)
+            gScrollStart = param16(0);
+        break;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+static void on_gpio(void*, uint gpio, bool value)
+{
+    if (gpio == LCD_CSX)
+        gChipSelected = !value;
+    else if (gpio == LCD_DCX)
+        gDataMode = value;
+}
+
+static void on_spi_write(void*, const spi_inst_t* spi, const void* frames, size_t count, uint dataBits)
+{
+    if (spi != LCD_SPI || !gChipSelected)
+        return;
+
+    const int bytesPerFrame = (dataBits > 8) ? 2 : 1;
+    if (!gDataMode)
+    {
+        gStats.CmdBytes += count * bytesPerFrame;
+
+        // only the low byte of a command frame means anything
+        for (size_t i = 0; i < count; ++i)
+            begin_cmd((bytesPerFrame == 1) ? ((const uint8_t*)frames)[i] : uint8_t(((const uint16_t*)frames)[i]));
+        return;
+    }
+
+    gStats.DataBytes += count * bytesPerFrame;
+
+    if (bytesPerFrame == 2)
+    {
+        const uint16_t* frame = (const uint16_t*)frames;
+
+        // the common case: whole pixels
+        if (gCmd == LCD_CMD_RAMWR && !gHavePixelByte)
+        {
+            for (size_t i = 0; i < count; ++i)
+                put_pixel(frame[i]);
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            data_byte(uint8_t(frame[i] >> 8));
+            data_byte(uint8_t(frame[i]));
+        }
+        return;
+    }
+
+    const uint8_t* bytes = (const uint8_t*)frames;
+    for (size_t i = 0; i < count; ++i)
+        data_byte(bytes[i]);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void lcdsim_attach()
+{
+    static const PicoStubListener listener = { nullptr, on_gpio, on_spi_write };
+    pico_stub_set_listener(&listener);
+}
+
+const LcdSimStats& lcdsim_stats()
+{
+    return gStats;
+}
+
+void lcdsim_reset_stats()
+{
+    memset(&gStats, 0, sizeof(gStats));
+}
+
+void lcdsim_get_screen_row(int y, uint16_t* row)
+{
+    // the fixed areas sit at either end of the frame memory, and the rest of it scrolls
+    int memY;
+    if (y < gTopFixed)
+    {
+        memY = y;
+    }
+    else if (y >= HEIGHT - gBottomFixed)
+    {
+        memY = FRAME_HEIGHT - (HEIGHT - y);
+    }
+    else
+    {
+        const int scrollHeight = FRAME_HEIGHT - gTopFixed - gBottomFixed;
+        const int offset = ((gScrollStart - gTopFixed) + (y - gTopFixed)) % scrollHeight;
+        memY = gTopFixed + ((offset < 0) ? (offset + scrollHeight) : offset);
+    }
+
+    memcpy(row, gFrameMem[memY], sizeof(gFrameMem[memY]));
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+#pragma once
+
+//
+//  lcdsim
+//
+//  A stand-in for the PicoCalc's LCD controller on the host. It listens to what drivers/lcd.c
+//  sends over the pico stand-in's SPI and decodes it into the controller's 320x480 frame memory,
+//  counting the traffic as it goes, so what the driver draws (and what it costs to draw it)
+//  can be checked off-device.
+//
+//  Only the commands the driver uses are modelled: CASET/RASET/RAMWR windows and the
+//  VSCRDEF/VSCSAD vertical scrolling. MADCTL is ignored, so the frame memory is in the
+//  driver's own (logical) orientation.
+//
+
+#include <cstdint>
+
+//-------------------------------------------------------------------------------------------------
+
+struct LcdSimStats
+{
+    uint32_t Commands;
+    uint32_t CmdBytes;
+    uint32_t DataBytes;     // command parameters and pixels
+    uint32_t WindowSets;    // each RAMWR starts writing a new window
+    uint32_t Pixels;
+};
+
+// starts decoding the pico stand-in's SPI traffic
+void lcdsim_attach();
+
+const LcdSimStats& lcdsim_stats();
+void lcdsim_reset_stats();
+
+// fills row with the 320 RGB565 pixels currently showing on line y of the screen, taking the
+// scroll position into account
+void lcdsim_get_screen_row(int y, uint16_t* row);
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,48 @@
+#pragma once
+
+// host stand-in for the pico sdk; see pico_stub.h
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+enum dma_channel_transfer_size
+{
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+typedef struct
+{
+    enum dma_channel_transfer_size size;
+    uint dreq;
+    bool read_increment;
+    bool write_increment;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size);
+void channel_config_set_dreq(dma_channel_config* c, uint dreq);
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint transfer_count, bool trigger);
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void* read_addr, uint32_t transfer_count);
+
+// a transfer only actually happens when something checks on it; see pico_stub.h
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+
+//-------------------------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
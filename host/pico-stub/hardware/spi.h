@@ -0,0 +1,55 @@
+#pragma once
+
+// host stand-in for the pico sdk; see pico_stub.h
+
+#include "pico/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+    volatile uint32_t dr;       // writes to here are clocked out (only by dma here)
+    volatile uint32_t icr;
+} spi_hw_t;
+
+typedef struct spi_inst
+{
+    spi_hw_t hw;
+    uint data_bits;
+} spi_inst_t;
+
+extern spi_inst_t pico_stub_spi[2];
+
+#define spi0 (&pico_stub_spi[0])
+#define spi1 (&pico_stub_spi[1])
+
+typedef enum { SPI_CPOL_0 = 0, SPI_CPOL_1 = 1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0 = 0, SPI_CPHA_1 = 1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1 } spi_order_t;
+
+#define SPI_SSPICR_RORIC_BITS 0x00000001u
+
+//-------------------------------------------------------------------------------------------------
+
+uint spi_init(spi_inst_t* spi, uint baudrate);
+void spi_set_format(spi_inst_t* spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+
+int spi_write_blocking(spi_inst_t* spi, const uint8_t* src, size_t len);
+int spi_write16_blocking(spi_inst_t* spi, const uint16_t* src, size_t len);
+
+// the bus is infinitely fast and nothing ever comes back
+static inline bool spi_is_busy(const spi_inst_t* spi) { (void)spi; return false; }
+static inline bool spi_is_readable(const spi_inst_t* spi) { (void)spi; return false; }
+
+static inline spi_hw_t* spi_get_hw(spi_inst_t* spi) { return &spi->hw; }
+uint spi_get_dreq(spi_inst_t* spi, bool is_tx);
+
+//-------------------------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+// host stand-in for the pico sdk; see pico_stub.h
+// there's no second core here (libcalc's worker uses a thread instead)
+
+#include "pico/types.h"
@@ -0,0 +1,58 @@
+#pragma once
+
+// host stand-in for the pico sdk; see pico_stub.h
+
+#include "pico/types.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function
+{
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5,
+};
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_put(uint gpio, bool value);
+
+//-------------------------------------------------------------------------------------------------
+
+void busy_wait_us(uint64_t delay_us);
+static inline void tight_loop_contents(void) {}
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+//-------------------------------------------------------------------------------------------------
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t* rt);
+
+struct repeating_timer
+{
+    int64_t delay_us;
+    repeating_timer_callback_t callback;
+    void* user_data;
+};
+
+// timers never go off by themselves; see pico_stub_fire_timers
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void* user_data, repeating_timer_t* out);
+
+//-------------------------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
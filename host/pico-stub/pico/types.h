@@ -0,0 +1,9 @@
+#pragma once
+
+// host stand-in for the pico sdk; see pico_stub.h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
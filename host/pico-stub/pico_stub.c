@@ -0,0 +1,320 @@
+#include "pico_stub.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------
+
+static PicoStubListener gListener;
+static PicoStubStats gStats;
+
+void pico_stub_set_listener(const PicoStubListener* listener)
+{
+    if (listener)
+        gListener = *listener;
+    else
+        memset(&gListener, 0, sizeof(gListener));
+}
+
+const PicoStubStats* pico_stub_get_stats(void)
+{
+    return &gStats;
+}
+
+void pico_stub_reset_stats(void)
+{
+    memset(&gStats, 0, sizeof(gStats));
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void gpio_init(uint gpio)
+{
+    (void)gpio;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    (void)gpio;
+    (void)out;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    if (gListener.OnGpio)
+        gListener.OnGpio(gListener.User, gpio, value);
+}
+
+void busy_wait_us(uint64_t delay_us)
+{
+    (void)delay_us;
+}
+
+static uint32_t gIrqDisableCount = 0;
+
+uint32_t save_and_disable_interrupts(void)
+{
+    return gIrqDisableCount++;
+}
+
+void restore_interrupts(uint32_t status)
+{
+    gIrqDisableCount = status;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+#define MAX_TIMERS 4
+
+static repeating_timer_t* gTimers[MAX_TIMERS];
+static int gNumTimers = 0;
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void* user_data, repeating_timer_t* out)
+{
+    if (gNumTimers >= MAX_TIMERS)
+        return false;
+
+    out->delay_us = delay_ms * 1000LL;
+    out->callback = callback;
+    out->user_data = user_data;
+    gTimers[gNumTimers++] = out;
+    return true;
+}
+
+void pico_stub_fire_timers(void)
+{
+    // as with real interrupts, these can't go off while they're disabled
+    if (gIrqDisableCount > 0)
+        return;
+
+    for (int i = 0; i < gNumTimers; ++i)
+        gTimers[i]->callback(gTimers[i]);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+spi_inst_t pico_stub_spi[2];
+
+#define MAX_DMA_CHANNELS 12
+
+typedef struct
+{
+    bool Claimed;
+    bool Busy;
+    dma_channel_config Config;
+    volatile void* WriteAddr;
+    const volatile void* ReadAddr;
+    uint32_t Count;
+} DmaChannel;
+
+static DmaChannel gDma[MAX_DMA_CHANNELS];
+
+// true if a dma transfer is still waiting to feed spi
+static bool is_dma_feeding(const spi_inst_t* spi)
+{
+    for (int i = 0; i < MAX_DMA_CHANNELS; ++i)
+    {
+        if (gDma[i].Busy && gDma[i].WriteAddr == &spi->hw.dr)
+            return true;
+    }
+    return false;
+}
+
+static void spi_send(const spi_inst_t* spi, const void* frames, size_t count)
+{
+    gStats.SpiFrames += count;
+    gStats.SpiBytes += count * ((spi->data_bits + 7) / 8);
+
+    if (gListener.OnSpiWrite)
+        gListener.OnSpiWrite(gListener.User, spi, frames, count, spi->data_bits);
+}
+
+uint spi_init(spi_inst_t* spi, uint baudrate)
+{
+    spi->data_bits = 8;
+    return baudrate;
+}
+
+void spi_set_format(spi_inst_t* spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order)
+{
+    (void)cpol;
+    (void)cpha;
+    (void)order;
+
+    if (is_dma_feeding(spi))
+        ++gStats.BusCollisions;
+
+    spi->data_bits = data_bits;
+}
+
+int spi_write_blocking(spi_inst_t* spi, const uint8_t* src, size_t len)
+{
+    if (is_dma_feeding(spi))
+        ++gStats.BusCollisions;
+
+    spi_send(spi, src, len);
+    return (int)len;
+}
+
+int spi_write16_blocking(spi_inst_t* spi, const uint16_t* src, size_t len)
+{
+    if (is_dma_feeding(spi))
+        ++gStats.BusCollisions;
+
+    spi_send(spi, src, len);
+    return (int)len;
+}
+
+uint spi_get_dreq(spi_inst_t* spi, bool is_tx)
+{
+    return (uint)((spi - pico_stub_spi) * 2 + (is_tx ? 0 : 1));
+}
+
+//-------------------------------------------------------------------------------------------------
+
+int dma_claim_unused_channel(bool required)
+{
+    for (int i = 0; i < MAX_DMA_CHANNELS; ++i)
+    {
+        if (!gDma[i].Claimed)
+        {
+            gDma[i].Claimed = true;
+            return i;
+        }
+    }
+
+    if (required)
+    {
+        fprintf(stderr, "pico_stub: no free dma channels\n");
+        abort();
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    (void)channel;
+
+    dma_channel_config c = { DMA_SIZE_32, 0, true, false };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size)
+{
+    c->size = size;
+}
+
+void channel_config_set_dreq(dma_channel_config* c, uint dreq)
+{
+    c->dreq = dreq;
+}
+
+void channel_config_set_read_increment(dma_channel_config* c, bool incr)
+{
+    c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config* c, bool incr)
+{
+    c->write_increment = incr;
+}
+
+// carries out a transfer in one go
+static void dma_run(DmaChannel* chan)
+{
+    if (!chan->Busy)
+        return;
+
+    const size_t size = (size_t)1 << chan->Config.size;
+
+    const spi_inst_t* spi = NULL;
+    for (int i = 0; i < 2; ++i)
+    {
+        if (chan->WriteAddr == &pico_stub_spi[i].hw.dr)
+            spi = &pico_stub_spi[i];
+    }
+
+    // it's no longer feeding the spi once it's gone
+    chan->Busy = false;
+    ++gStats.DmaTransfers;
+
+    if (spi)
+    {
+        // the fifo is as wide as the frame, whatever size the dma writes it with
+        if (chan->Config.read_increment && size == (spi->data_bits + 7) / 8)
+        {
+            spi_send(spi, (const void*)chan->ReadAddr, chan->Count);
+        }
+        else
+        {
+            const uint8_t* src = (const uint8_t*)chan->ReadAddr;
+            for (uint32_t i = 0; i < chan->Count; ++i, src += chan->Config.read_increment ? size : 0)
+            {
+                uint16_t frame = 0;
+                memcpy(&frame, src, (size < sizeof(frame)) ? size : sizeof(frame));
+                if (spi->data_bits <= 8)
+                {
+                    const uint8_t frame8 = (uint8_t)frame;
+                    spi_send(spi, &frame8, 1);
+                }
+                else
+                {
+                    spi_send(spi, &frame, 1);
+                }
+            }
+        }
+        return;
+    }
+
+    // anything else is a plain copy
+    const uint8_t* src = (const uint8_t*)chan->ReadAddr;
+    uint8_t* dst = (uint8_t*)chan->WriteAddr;
+    for (uint32_t i = 0; i < chan->Count; ++i)
+    {
+        memcpy(dst, src, size);
+        src += chan->Config.read_increment ? size : 0;
+        dst += chan->Config.write_increment ? size : 0;
+    }
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint transfer_count, bool trigger)
+{
+    DmaChannel* chan = &gDma[channel];
+    dma_run(chan);
+
+    chan->Config = *config;
+    chan->WriteAddr = write_addr;
+    chan->ReadAddr = read_addr;
+    chan->Count = transfer_count;
+    chan->Busy = trigger;
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void* read_addr, uint32_t transfer_count)
+{
+    DmaChannel* chan = &gDma[channel];
+    dma_run(chan);
+
+    chan->ReadAddr = read_addr;
+    chan->Count = transfer_count;
+    chan->Busy = true;
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+    dma_run(&gDma[channel]);
+    return false;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel)
+{
+    dma_run(&gDma[channel]);
+}
+
+//-------------------------------------------------------------------------------------------------
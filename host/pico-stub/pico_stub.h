@@ -0,0 +1,61 @@
+#pragma once
+
+// a host stand-in for the parts of the pico sdk the drivers use (gpio, spi, dma and timers),
+// so they can be built and exercised off-device
+// nothing is wired up to anything: everything that would have gone out over the pins is
+// passed on to a listener instead (eg. something pretending to be the LCD), and counted
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/spi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+    void* User;
+    void (*OnGpio)(void* user, uint gpio, bool value);
+
+    // frames are data_bits wide (as set by spi_set_format), so they're uint8_t for 8 bits or
+    // fewer and uint16_t otherwise
+    void (*OnSpiWrite)(void* user, const spi_inst_t* spi, const void* frames, size_t count, uint data_bits);
+} PicoStubListener;
+
+// null to stop listening
+void pico_stub_set_listener(const PicoStubListener* listener);
+
+//-------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t SpiFrames;
+    uint64_t SpiBytes;
+    uint32_t DmaTransfers;
+
+    // spi writes and format changes that happened while a dma transfer was still feeding the
+    // same spi. on the pico these would corrupt or be corrupted by the transfer
+    uint32_t BusCollisions;
+} PicoStubStats;
+
+const PicoStubStats* pico_stub_get_stats(void);
+void pico_stub_reset_stats(void);
+
+//-------------------------------------------------------------------------------------------------
+
+// dma transfers don't copy anything when they're started; they're carried out in one go when
+// something next checks on them (dma_channel_is_busy/dma_channel_wait_for_finish_blocking).
+// so if the source buffer is changed before then, the listener sees the changed pixels, which
+// is how overwriting a buffer that's still being sent would go wrong on the pico too
+
+// fires every repeating timer once, as if their interrupts had all gone off now
+void pico_stub_fire_timers(void);
+
+//-------------------------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
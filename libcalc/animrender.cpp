@@ -1,5 +1,8 @@
 #include "animrender.h"
 
+#include "worker.h"
+
+#include <algorithm>
 #include <cstring>
 
 #if MLN_TARGET_PC
@@ -14,8 +17,95 @@ extern void render();
 #include "drivers/keyboard.h"
 #include "drivers/lcd.h"
 
+#include "pico/time.h"
+
+#elif MLN_TARGET_HEADLESS
+
+static int gHeadlessFrameLimit = 60;
+static uint16_t gHeadlessSurface[TinyScopeFrameBuf::IMGH][TinyScopeFrameBuf::IMGW];
+
+static AnimBlitFn gHeadlessBlit = nullptr;
+static AnimWaitFn gHeadlessWait = nullptr;
+
+void anim_set_headless_frame_limit(int frames)
+{
+    gHeadlessFrameLimit = frames;
+}
+
+void anim_set_headless_blit(AnimBlitFn blit, AnimWaitFn wait)
+{
+    gHeadlessBlit = blit;
+    gHeadlessWait = wait;
+}
+
 #endif
 
+#if MLN_TARGET_PICO
+
+static uint64_t anim_time_us()
+{
+    return time_us_64();
+}
+
+#else
+
+#include <chrono>
+
+static uint64_t anim_time_us()
+{
+    using namespace std::chrono;
+    return uint64_t(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+#endif
+
+// on the pico, core 1 sends (and darkens) each frame while core 0 integrates the next one
+// SDL wants rendering kept to the main thread, so the pc doesn't
+#if MLN_TARGET_PICO
+static bool gAnimPipelined = true;
+#else
+static bool gAnimPipelined = false;
+#endif
+
+// the headless build runs a fixed number of steps a frame, so its pictures are reproducible
+#if MLN_TARGET_HEADLESS
+static bool gAnimScheduled = false;
+#else
+static bool gAnimScheduled = true;
+#endif
+
+#if MLN_TARGET_HEADLESS
+void anim_set_pipelined(bool pipelined)
+{
+    gAnimPipelined = pipelined;
+}
+
+void anim_set_scheduled(bool scheduled)
+{
+    gAnimScheduled = scheduled;
+}
+#endif
+
+static AnimStats gAnimStats;
+
+const AnimStats& anim_get_stats()
+{
+    return gAnimStats;
+}
+
+// check_for_break is only called between frames, so no frame integrates for longer than this
+static constexpr uint32_t kMaxFrameUs = 100000;
+
+// how long a step takes isn't known until a frame's been timed, and for a poincare section a
+// step is a whole cycle of the forcing, so scheduled frames start this small. they then grow
+// by at most kMaxFrameGrowth times a frame, so one frame that was timed badly can't blow it
+static constexpr int kFirstFrameSteps = 4;
+static constexpr int kMaxFrameGrowth = 4;
+static constexpr int kMaxFrameSteps = 1 << 22;
+
+// only one animation runs at once, so they can share this
+static TinyScopePointBuf gAnimPoints;
+
 //-------------------------------------------------------------------------------------------------
 
 // warmly darken an RGB565 colour by ~10%
@@ -80,44 +170,154 @@ const uint16_t TinyScopeFrameBuf::kPalette[16] =
     darkenTimes< 0>(COL_TinyScope),
 };
 
+// a byte of the frame buffer (two pixels) expanded to the two colours it stands for, packed so
+// one 32-bit store lays them out in memory in the right order
+struct PalettePairs
+{
+    uint32_t Pairs[256];
+};
+
+static constexpr PalettePairs make_palette_pairs()
+{
+    PalettePairs pairs {};
+    for (int i = 0; i < 256; ++i)
+    {
+        const uint32_t first = TinyScopeFrameBuf::kPalette[i >> 4];
+        const uint32_t second = TinyScopeFrameBuf::kPalette[i & 0xf];
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        pairs.Pairs[i] = (first << 16) | second;
+#else
+        pairs.Pairs[i] = first | (second << 16);
+#endif
+    }
+    return pairs;
+}
+
+static constexpr PalettePairs kPalettePairs = make_palette_pairs();
+
+// a byte of a TinyScopePointBuf (8 pixels, first one in the top bit) expanded to the word of the
+// frame buffer that covers the same pixels, with every nibble that has a point at full brightness
+struct PointMasks
+{
+    uint32_t Masks[256];
+};
+
+static constexpr PointMasks make_point_masks()
+{
+    PointMasks masks {};
+    for (int i = 0; i < 256; ++i)
+    {
+        for (int px = 0; px < 8; ++px)
+        {
+            if (!(i & (0x80 >> px)))
+                continue;
+
+            // pixels go two to a byte, the first in the high nibble
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            const int byteShift = (3 - (px / 2)) * 8;
+#else
+            const int byteShift = (px / 2) * 8;
+#endif
+            masks.Masks[i] |= 0xfu << (byteShift + ((px & 1) ? 0 : 4));
+        }
+    }
+    return masks;
+}
+
+static constexpr PointMasks kPointMasks = make_point_masks();
+
+// knocks one off every non-zero nibble of a word, without borrowing from the next one along
+static inline uint32_t decay_nibbles(uint32_t w)
+{
+    uint32_t nonZero = w | (w >> 1);
+    nonZero |= (nonZero >> 2);
+    return w - (nonZero & 0x11111111u);
+}
+
 TinyScopeFrameBuf::TinyScopeFrameBuf()
 {
-    memset(mPix, 0, sizeof(mPix));
+    memset(mPixWords, 0, sizeof(mPixWords));
+    memset(mDirtyRows, 0xff, sizeof(mDirtyRows));
+    memset(mLitRows, 0, sizeof(mLitRows));
 }
 
 
 void TinyScopeFrameBuf::tick()
 {
-    const uint8_t* endPix = mPix + (IMGH * ROWPITCH_BYTES);
-    for (uint8_t* ppix = mPix; ppix != endPix; ++ppix)
+    for (int y = 0; y < IMGH; ++y)
+    {
+        const uint32_t rowBit = 1u << (y % 32);
+        if (!(mLitRows[y / 32] & rowBit))
+            continue;
+
+        // anything lit gets darker, so the row's changed; it stays lit until it fades to black
+        // a word (8 pixels) at a time, with no branches
+        uint32_t lit = 0;
+        uint32_t* pword = mPixWords + (y * ROWPITCH_WORDS);
+        const uint32_t* endWord = pword + ROWPITCH_WORDS;
+        for (; pword != endWord; ++pword)
+        {
+            const uint32_t w = decay_nibbles(*pword);
+            *pword = w;
+            lit |= w;
+        }
+
+        mDirtyRows[y / 32] |= rowBit;
+        if (!lit)
+            mLitRows[y / 32] &= ~rowBit;
+    }
+}
+
+void TinyScopeFrameBuf::clearDirty()
+{
+    memset(mDirtyRows, 0, sizeof(mDirtyRows));
+}
+
+void TinyScopeFrameBuf::merge(TinyScopePointBuf& points)
+{
+    static_assert(TinyScopePointBuf::ROWPITCH_BYTES == ROWPITCH_WORDS, "a point byte covers a frame buffer word");
+
+    for (int y = 0; y < IMGH; ++y)
     {
-        uint8_t pix = *ppix;
-        if (pix)
+        const uint32_t rowBit = 1u << (y % 32);
+        if (!(points.mRows[y / 32] & rowBit))
+            continue;
+
+        uint8_t* bits = points.mBits + (y * TinyScopePointBuf::ROWPITCH_BYTES);
+        uint32_t* pword = mPixWords + (y * ROWPITCH_WORDS);
+        for (int i = 0; i < ROWPITCH_WORDS; ++i)
         {
-            uint8_t pix0 = pix & 0xf0;
-            uint8_t pix1 = pix & 0x0f;
-            if (pix0)
-                pix0 -= 0x10;
-            if (pix1)
-                --pix1;
-            *ppix = pix0 | pix1;
+            pword[i] |= kPointMasks.Masks[bits[i]];
         }
+        memset(bits, 0, TinyScopePointBuf::ROWPITCH_BYTES);
+
+        mDirtyRows[y / 32] |= rowBit;
+        mLitRows[y / 32] |= rowBit;
     }
+
+    memset(points.mRows, 0, sizeof(points.mRows));
+}
+
+//-------------------------------------------------------------------------------------------------
+
+TinyScopePointBuf::TinyScopePointBuf()
+{
+    memset(mBits, 0, sizeof(mBits));
+    memset(mRows, 0, sizeof(mRows));
 }
 
 
 void TinyScopeFrameBuf::getRow(int y, uint16_t* rowBuf) const
 {
-    const uint8_t* ppix = mPix + (y * ROWPITCH_BYTES);
+    const uint8_t* ppix = pixBytes() + (y * ROWPITCH_BYTES);
     const uint8_t* pixEnd = ppix + ROWPITCH_BYTES;
 
     uint16_t* outPix = rowBuf;
 
-    for (; ppix != pixEnd; ++ppix)
+    // rowBuf might only be 2-byte aligned, which memcpy copes with and still does in one store
+    for (; ppix != pixEnd; ++ppix, outPix += 2)
     {
-        const uint8_t pix = *ppix;
-        *(outPix++) = kPalette[pix >> 4];
-        *(outPix++) = kPalette[pix & 0xf];
+        memcpy(outPix, &kPalettePairs.Pairs[*ppix], sizeof(uint32_t));
     }
 }
 
@@ -141,10 +341,18 @@ AnimRenderer::AnimRenderer(float minX, float maxX, float minY, float maxY)
     lcd_enable_cursor(false);
 
 #endif
+
+    if (gAnimPipelined)
+        mPoints = &gAnimPoints;
+
+    gAnimStats = AnimStats {};
+    mStartUs = anim_time_us();
 }
 
 AnimRenderer::~AnimRenderer()
 {
+    finishFrame();
+
 #if MLN_TARGET_PC
     SDL_FreeSurface(mSurf);
     mSurf = nullptr;
@@ -163,7 +371,35 @@ void AnimRenderer::darken()
     mFb.tick();
 }
 
-void AnimRenderer::blit() const
+#if MLN_TARGET_PICO || MLN_TARGET_HEADLESS
+
+// expands fb's dirty rows one at a time, each one while the one before is still being sent
+template<typename BlitFn, typename WaitFn>
+static void blit_rows(const TinyScopeFrameBuf& fb, BlitFn blit, WaitFn wait)
+{
+    constexpr int IMGW = TinyScopeFrameBuf::IMGW;
+    constexpr int IMGH = TinyScopeFrameBuf::IMGH;
+
+    static uint16_t rows[2][IMGW];
+    const int x = TinyScopeFrameBuf::BORDER;
+    int y = TinyScopeFrameBuf::BORDER;
+    int sent = 0;
+    for (int i=0; i<IMGH; ++i, ++y)
+    {
+        if (!fb.isRowDirty(i))
+            continue;
+
+        uint16_t* row = rows[sent++ & 1];
+        fb.getRow(i, row);
+
+        blit(row, x, y, IMGW, 1);
+    }
+    wait();
+}
+
+#endif
+
+void AnimRenderer::blit()
 {
 #if MLN_TARGET_PC
 
@@ -173,7 +409,8 @@ void AnimRenderer::blit() const
     uint16_t* row = reinterpret_cast<uint16_t*>(mSurf->pixels);
     for (int i=0; i<IMGH; ++i, row += stride)
     {
-        mFb.getRow(i, row);
+        if (mFb.isRowDirty(i))
+            mFb.getRow(i, row);
     }
 
     SDL_UnlockSurface(mSurf);
@@ -184,18 +421,109 @@ void AnimRenderer::blit() const
 
 #elif MLN_TARGET_PICO
 
-    // expand row-by-row to local array and then blit each of those in turn
-    uint16_t row[IMGW];
-    const int x = TinyScopeFrameBuf::BORDER;
-    int y = TinyScopeFrameBuf::BORDER;
-    for (int i=0; i<IMGH; ++i, ++y)
-    {
-        mFb.getRow(i, row);
+    blit_rows(mFb, lcd_blit_async, lcd_wait);
 
-        lcd_blit(row, x, y, IMGW, 1);
+#elif MLN_TARGET_HEADLESS
+
+    for (int i=0; i<IMGH; ++i)
+    {
+        if (mFb.isRowDirty(i))
+            mFb.getRow(i, gHeadlessSurface[i]);
     }
 
+    if (gHeadlessBlit)
+        blit_rows(mFb, gHeadlessBlit, gHeadlessWait);
+
 #endif
+
+    mFb.clearDirty();
+}
+
+void AnimRenderer::scheduleFrames(int fps, int fixedSteps)
+{
+    mFramePeriodUs = gAnimScheduled ? (1000000 / fps) : 0;
+    mSteps = mFramePeriodUs ? std::min(fixedSteps, kFirstFrameSteps) : fixedSteps;
+}
+
+int AnimRenderer::beginFrame()
+{
+    mFrameStartUs = anim_time_us();
+    return mSteps;
+}
+
+void AnimRenderer::scheduleNextFrame(uint32_t integrateUs, uint32_t blitUs)
+{
+    if (!mFramePeriodUs)
+        return;
+
+    // running averages, so one odd frame doesn't throw the size right out
+    const float usPerStep = float(integrateUs) / float(mSteps);
+    mUsPerStep = (mUsPerStep > 0) ? ((mUsPerStep * 3) + usPerStep) / 4 : usPerStep;
+    mBlitUs = ((mBlitUs * 3) + float(blitUs)) / 4;
+
+    // if the worker's sending the frame, integrating the next one can take as long as that does
+    // for free; otherwise the two have to share the frame, but integration always gets some
+    const float period = float(mFramePeriodUs);
+    float budget = mFrameInFlight ? std::max(period, mBlitUs) : std::max(period - mBlitUs, period / 4);
+    budget = std::min(budget, float(kMaxFrameUs));
+
+    const float steps = budget / std::max(mUsPerStep, 0.001f);
+    const float maxSteps = std::min(float(mSteps) * kMaxFrameGrowth, float(kMaxFrameSteps));
+    mSteps = int(std::min(std::max(steps, 1.0f), maxSteps));
+}
+
+void AnimRenderer::frame_job(void* arg)
+{
+    AnimRenderer* renderer = static_cast<AnimRenderer*>(arg);
+
+    const uint64_t startUs = anim_time_us();
+    renderer->blit();
+    if (renderer->mDarkenAfter)
+        renderer->darken();
+    renderer->mLastBlitUs = uint32_t(anim_time_us() - startUs);
+}
+
+void AnimRenderer::finishFrame()
+{
+    if (mFrameInFlight)
+    {
+        worker_wait();
+        mFrameInFlight = false;
+    }
+}
+
+void AnimRenderer::endFrame(bool darkenAfter)
+{
+    const uint64_t integratedUs = anim_time_us();
+
+    // the last frame has to be out of the way before this one's points can go in
+    finishFrame();
+    if (mPoints)
+        mFb.merge(*mPoints);
+
+    // the worker's still to send this frame, so it's the last one's blit time that's known
+    uint32_t blitUs = mLastBlitUs;
+    mDarkenAfter = darkenAfter;
+    if (mPoints && worker_try_start(frame_job, this))
+    {
+        mFrameInFlight = true;
+    }
+    else
+    {
+        frame_job(this);
+        blitUs = mLastBlitUs;
+    }
+
+    const uint64_t nowUs = anim_time_us();
+    const float secs = float(nowUs - mStartUs) * 1e-6f;
+    mTotalSteps += mSteps;
+
+    ++gAnimStats.Frames;
+    gAnimStats.StepsPerFrame = uint32_t(mSteps);
+    gAnimStats.Fps = (secs > 0) ? float(gAnimStats.Frames) / secs : 0;
+    gAnimStats.StepsPerSec = (secs > 0) ? float(mTotalSteps) / secs : 0;
+
+    scheduleNextFrame(uint32_t(integratedUs - mFrameStartUs), blitUs);
 }
 
 bool AnimRenderer::check_for_break()
@@ -208,6 +536,10 @@ bool AnimRenderer::check_for_break()
 
     return keyboard_key_available();
 
+#elif MLN_TARGET_HEADLESS
+
+    return (++mFramesRun >= gHeadlessFrameLimit);
+
 #endif
 }
 
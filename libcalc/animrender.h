@@ -10,8 +10,45 @@
 #endif
 
 
+#if MLN_TARGET_HEADLESS
+// there's no keyboard to break out of an animation with, so they just run for a fixed number
+// of frames
+void anim_set_headless_frame_limit(int frames);
+
+// frames are normally just rendered into memory; this sends them on a row at a time as well
+// (eg. to the lcd driver, running on the host), with blit and wait used like lcd_blit_async
+// and lcd_wait
+typedef void (*AnimBlitFn)(const uint16_t* pixels, int x, int y, int width, int height);
+typedef void (*AnimWaitFn)();
+void anim_set_headless_blit(AnimBlitFn blit, AnimWaitFn wait);
+
+// whether frames are sent by the worker while the next one is worked out (as on the pico), or
+// by the caller (the default here), so the two can be compared
+void anim_set_pipelined(bool pipelined);
+
+// frames normally run a fixed number of steps here, so what's drawn doesn't depend on how fast
+// the host is; this sizes them to the frame rate instead, as on the pico
+void anim_set_scheduled(bool scheduled);
+#endif
+
+// how the last (or current) animation ran, for tuning the frame scheduling
+// a step is whatever the animation counts its frames in: a time step for the diff eqns, or a
+// point for the poincare sections
+struct AnimStats
+{
+    uint32_t Frames;
+    uint32_t StepsPerFrame;     // the size of the last frame
+    float Fps;
+    float StepsPerSec;
+};
+
+const AnimStats& anim_get_stats();
+
+
 //-------------------------------------------------------------------------------------------------
 
+class TinyScopePointBuf;
+
 // a little "oscilloscope" frame buffer
 // uses 16-bit colours with a scopey palette
 class TinyScopeFrameBuf
@@ -38,12 +75,16 @@ public:
         if (y < 0 || y >= IMGH)
             return;
 
-        uint8_t* ppix = mPix + (y*ROWPITCH_BYTES + x/PIXELS_PER_BYTE);
+        uint8_t* ppix = pixBytes() + (y*ROWPITCH_BYTES + x/PIXELS_PER_BYTE);
 
         if (x & 1)  // low nybble
             *ppix |= 0x0f;
         else
             *ppix |= 0xf0;
+
+        const uint32_t rowBit = 1u << (y % 32);
+        mDirtyRows[y / 32] |= rowBit;
+        mLitRows[y / 32] |= rowBit;
     };
 
     // tick the screen so it darkens one step
@@ -52,17 +93,72 @@ public:
     // output one row as renderable pixels
     void getRow(int y, uint16_t* rowBuf) const;
 
+    // rows that have changed since the last clearDirty; everything starts off dirty, so the
+    // first frame covers whatever was on screen before
+    bool isRowDirty(int y) const { return (mDirtyRows[y / 32] >> (y % 32)) & 1; }
+    void clearDirty();
+
+    // lights up everything plotted in points, and empties it
+    void merge(TinyScopePointBuf& points);
+
 
 private:
     static constexpr int PIXELS_PER_BYTE = 2;
     static constexpr int ROWPITCH_BYTES = IMGW / PIXELS_PER_BYTE;
+    static constexpr int ROWPITCH_WORDS = ROWPITCH_BYTES / sizeof(uint32_t);
+    static constexpr int ROW_WORDS = (IMGH + 31) / 32;
+    static_assert(ROWPITCH_BYTES % sizeof(uint32_t) == 0, "tick works on whole words of a row");
 
-    uint8_t mPix[ROWPITCH_BYTES * IMGH];
+    // the pixels are stored as words, so tick can work on 8 at a time, but are mostly accessed
+    // as bytes
+    uint32_t mPixWords[ROWPITCH_WORDS * IMGH];
+
+    uint8_t* pixBytes() { return reinterpret_cast<uint8_t*>(mPixWords); }
+    const uint8_t* pixBytes() const { return reinterpret_cast<const uint8_t*>(mPixWords); }
+
+    // a bit per row: whether it's changed, and whether it has anything lit in it (tick can
+    // skip the rows that don't)
+    uint32_t mDirtyRows[ROW_WORDS];
+    uint32_t mLitRows[ROW_WORDS];
     
 };
 
 //-------------------------------------------------------------------------------------------------
 
+// the points plotted over one frame, at a bit per pixel, waiting to be merged into a
+// TinyScopeFrameBuf
+class TinyScopePointBuf
+{
+public:
+    static constexpr int IMGW = TinyScopeFrameBuf::IMGW;
+    static constexpr int IMGH = TinyScopeFrameBuf::IMGH;
+
+    TinyScopePointBuf();
+
+    void plot(int x, int y)
+    {
+        if (x < 0 || x >= IMGW)
+            return;
+        if (y < 0 || y >= IMGH)
+            return;
+
+        mBits[y*ROWPITCH_BYTES + x/8] |= uint8_t(0x80 >> (x & 7));
+        mRows[y / 32] |= 1u << (y % 32);
+    };
+
+private:
+    friend class TinyScopeFrameBuf;
+
+    // a byte here covers the same 8 pixels as a word of the frame buffer
+    static constexpr int ROWPITCH_BYTES = IMGW / 8;
+    static constexpr int ROW_WORDS = (IMGH + 31) / 32;
+
+    uint8_t mBits[ROWPITCH_BYTES * IMGH];
+    uint32_t mRows[ROW_WORDS];      // a bit per row with anything in it
+};
+
+//-------------------------------------------------------------------------------------------------
+
 class AnimRenderer
 {
     static constexpr int IMGW = TinyScopeFrameBuf::IMGW;
@@ -80,14 +176,31 @@ public:
 
     void safePlot(int x, int y)
     {
-        mFb.plot(x, y);
+        if (mPoints)
+            mPoints->plot(x, y);
+        else
+            mFb.plot(x, y);
     };
 
+    // frames are sized to take around 1/fps of a second, going on how long integrating and
+    // sending the last few took, starting from a few steps; fixedSteps is what's always used
+    // when frames aren't scheduled
+    void scheduleFrames(int fps, int fixedSteps);
+
+    // the number of steps to integrate before the next endFrame
+    int beginFrame();
+
     void fill(uint16_t col);
     
     void darken();
 
-    void blit() const;
+    // sends the rows that have changed since the last blit
+    void blit();
+
+    // blits the frame, then darkens it if asked
+    // when pipelined, points are plotted into a separate buffer, and this merges them in and
+    // hands the frame to the worker, so the next frame can be worked out while it's sent
+    void endFrame(bool darkenAfter);
 
     bool check_for_break();
 
@@ -95,10 +208,29 @@ public:
     inline int y(double realY) const { return int(mY.ToScreen(realY)); }
 
 private:
+    static void frame_job(void* arg);
+    void finishFrame();
+    void scheduleNextFrame(uint32_t integrateUs, uint32_t blitUs);
+
     TinyScopeFrameBuf mFb;
 
+    TinyScopePointBuf* mPoints = nullptr;   // set when pipelined
+    bool mFrameInFlight = false;
+    bool mDarkenAfter = false;
+
+    int mFramePeriodUs = 0;     // 0 if frames aren't scheduled
+    int mSteps = 0;
+    float mUsPerStep = 0;
+    float mBlitUs = 0;
+    uint32_t mLastBlitUs = 0;   // set by whoever sent the last frame (which may be the worker)
+    uint64_t mStartUs = 0;
+    uint64_t mFrameStartUs = 0;
+    uint64_t mTotalSteps = 0;
+
 #if MLN_TARGET_PC
     SDL_Surface* mSurf = nullptr;
+#elif MLN_TARGET_HEADLESS
+    int mFramesRun = 0;
 #endif
 
     const PlotAxis mAxisX, mAxisY;
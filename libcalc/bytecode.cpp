@@ -0,0 +1,446 @@
+#include "bytecode.h"
+
+#include "funcs.h"
+#include "maths.h"
+#include "session.h"
+#include "symbols.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+// how much each op changes the depth of the stack
+static constexpr int8_t kOpStackEffect[] =
+{
+    +1, +1, +1,     // Const, LoadVar, LoadArg
+    0, 0,           // CallBuiltin, CallUser
+    0,              // Negate
+    -1, -1,         // Add, Subtract
+    -1, -1,         // Multiply, Divide
+    -1,             // Power
+    0,              // Factorial
+};
+static_assert((sizeof(kOpStackEffect) / sizeof(kOpStackEffect[0])) == size_t(OpCode::COUNT));
+
+//-------------------------------------------------------------------------------------------------
+
+void program_reset(Program& prog)
+{
+    prog.NumOps = 0;
+    prog.NumConsts = 0;
+    prog.StackDepth = 0;
+    prog.MaxStackDepth = 0;
+}
+
+bool program_emit(Program& prog, OpCode code, ParseCtx& ctx, uint8_t operand)
+{
+    if (ctx.Error)
+        return false;
+
+    if (prog.NumOps >= kMaxProgramOps)
+    {
+        on_parse_error(ctx, "expression too long");
+        return false;
+    }
+
+    const int depth = prog.StackDepth + kOpStackEffect[int(code)];
+    if (depth > kMaxEvalStack)
+    {
+        on_parse_error(ctx, "expression too complex");
+        return false;
+    }
+
+    prog.StackDepth = uint8_t(depth);
+    if (prog.StackDepth > prog.MaxStackDepth)
+        prog.MaxStackDepth = prog.StackDepth;
+
+    prog.Ops[prog.NumOps++] = { .Code = code, .Operand = operand };
+    return true;
+}
+
+bool program_emit_const(Program& prog, double val, ParseCtx& ctx)
+{
+    if (ctx.Error)
+        return false;
+
+    // share repeated constants (2pi/3 + 2 etc)
+    int ix = 0;
+    for (; ix < prog.NumConsts; ++ix)
+    {
+        if (memcmp(&prog.Consts[ix], &val, sizeof(val)) == 0)
+            break;
+    }
+
+    if (ix == prog.NumConsts)
+    {
+        if (prog.NumConsts >= kMaxProgramConsts)
+        {
+            on_parse_error(ctx, "too many numbers");
+            return false;
+        }
+        prog.Consts[prog.NumConsts++] = val;
+    }
+
+    return program_emit(prog, OpCode::Const, ctx, uint8_t(ix));
+}
+
+bool program_emit_named(Program& prog, OpCode code, NameId name, ParseCtx& ctx)
+{
+    if (ctx.Error)
+        return false;
+
+    if (name == kInvalidName)
+    {
+        on_parse_error(ctx, "too many names");
+        return false;
+    }
+
+    return program_emit(prog, code, ctx, name);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// kept out of line so the message buffer isn't on the stack for every level of a call
+__attribute__((noinline)) static void on_unknown_name(ParseCtx& ctx, const char* what, NameId name)
+{
+    char errBuf[20+kMaxSymbolLength+1];
+    sprintf(errBuf, "unknown %s: %s", what, name_str(ctx.Session->Names, name));
+    on_parse_error(ctx, errBuf);
+}
+
+static EvalStack& eval_stack(ParseCtx& ctx)
+{
+    return ctx.Stack ? *ctx.Stack : ctx.Session->Stacks[0];
+}
+
+double run_program(const Program& prog, const double* args, ParseCtx& ctx)
+{
+    double* stack = eval_stack(ctx).Frames[ctx.CallDepth].Vals;
+    double* top = stack - 1;
+
+    const Op* op = prog.Ops;
+    const Op* opEnd = op + prog.NumOps;
+    for (; op != opEnd; ++op)
+    {
+        switch (op->Code)
+        {
+        case OpCode::Const:
+            *(++top) = prog.Consts[op->Operand];
+            break;
+
+        case OpCode::LoadVar:
+            if (!eval_user_value(*ctx.Session, op->Operand, *(++top)))
+            {
+                on_unknown_name(ctx, "named val", op->Operand);
+                return 0.0;
+            }
+            break;
+
+        case OpCode::LoadArg:
+            if (!args)
+            {
+                on_parse_error(ctx, "no args here");
+                return 0.0;
+            }
+            *(++top) = args[op->Operand];
+            break;
+
+        case OpCode::CallBuiltin:
+            *top = call_builtin_function(op->Operand, *top);
+            break;
+
+        case OpCode::CallUser:
+        {
+            const UserFunction* func = lookup_user_func(*ctx.Session, op->Operand);
+            if (!func)
+            {
+                on_unknown_name(ctx, "func", op->Operand);
+                return 0.0;
+            }
+
+            *top = eval_user_func(func, *top, ctx);
+            if (ctx.Error)
+                return 0.0;
+            break;
+        }
+
+        case OpCode::Negate:    *top = -*top;                   break;
+        case OpCode::Add:       top[-1] = top[-1] + top[0]; --top;  break;
+        case OpCode::Subtract:  top[-1] = top[-1] - top[0]; --top;  break;
+        case OpCode::Multiply:  top[-1] = top[-1] * top[0]; --top;  break;
+        case OpCode::Divide:    top[-1] = top[-1] / top[0]; --top;  break;
+        case OpCode::Power:     top[-1] = std::pow(top[-1], top[0]); --top;  break;
+
+        case OpCode::Factorial:
+            if (!compute_factorial(*top))
+            {
+                on_parse_error(ctx, "need a positive integer");
+                return 0.0;
+            }
+            break;
+
+        case OpCode::COUNT:
+            on_parse_error(ctx, "corrupt program");
+            return 0.0;
+        }
+    }
+
+    if (top < stack)
+        return 0.0;
+
+    return *top;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the lane loops below work on one stack slot's worth of lanes, and always run the full width
+// with no aliasing so that the compiler can vectorise them
+
+static inline void lanes_fill(double* __restrict out, double val)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        out[i] = val;
+}
+
+static inline void lanes_copy(double* __restrict out, const double* __restrict in)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        out[i] = in[i];
+}
+
+static inline void lanes_negate(double* __restrict a)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        a[i] = -a[i];
+}
+
+static inline void lanes_add(double* __restrict a, const double* __restrict b)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        a[i] = a[i] + b[i];
+}
+
+static inline void lanes_subtract(double* __restrict a, const double* __restrict b)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        a[i] = a[i] - b[i];
+}
+
+static inline void lanes_multiply(double* __restrict a, const double* __restrict b)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        a[i] = a[i] * b[i];
+}
+
+static inline void lanes_divide(double* __restrict a, const double* __restrict b)
+{
+    for (int i = 0; i < kBatchLanes; ++i)
+        a[i] = a[i] / b[i];
+}
+
+static void fill_nans(double* ys, int n)
+{
+    for (int i = 0; i < n; ++i)
+        ys[i] = 0.0 / 0.0;
+}
+
+bool run_program_batch(const Program& prog, const double* xs, double* ys, int n, ParseCtx& ctx)
+{
+    // check all the names up front so a missing one fails before we've done any work
+    double unused;
+    for (const Op* op = prog.Ops; op != prog.Ops + prog.NumOps; ++op)
+    {
+        if (op->Code == OpCode::LoadVar)
+        {
+            if (!eval_user_value(*ctx.Session, op->Operand, unused))
+            {
+                on_unknown_name(ctx, "named val", op->Operand);
+                fill_nans(ys, n);
+                return false;
+            }
+        }
+        else if (op->Code == OpCode::CallUser)
+        {
+            if (!lookup_user_func(*ctx.Session, op->Operand))
+            {
+                on_unknown_name(ctx, "func", op->Operand);
+                fill_nans(ys, n);
+                return false;
+            }
+        }
+    }
+
+    EvalStack& evalStack = eval_stack(ctx);
+    auto& stack = evalStack.Slots;
+    double* xLanes = evalStack.Xs;
+
+    for (int base = 0; base < n; base += kBatchLanes)
+    {
+        const int count = std::min(kBatchLanes, n - base);
+
+        // pad a short final batch with copies of its last x so the lane loops stay full width
+        for (int i = 0; i < kBatchLanes; ++i)
+            xLanes[i] = xs[base + std::min(i, count - 1)];
+
+        int top = -1;
+
+        const Op* op = prog.Ops;
+        const Op* opEnd = op + prog.NumOps;
+        for (; op != opEnd; ++op)
+        {
+            switch (op->Code)
+            {
+            case OpCode::Const:
+                lanes_fill(stack[++top], prog.Consts[op->Operand]);
+                break;
+
+            case OpCode::LoadVar:
+            {
+                double val;
+                eval_user_value(*ctx.Session, op->Operand, val);
+                lanes_fill(stack[++top], val);
+                break;
+            }
+
+            case OpCode::LoadArg:
+                lanes_copy(stack[++top], xLanes);
+                break;
+
+            case OpCode::CallBuiltin:
+                for (int i = 0; i < count; ++i)
+                    stack[top][i] = call_builtin_function(op->Operand, stack[top][i]);
+                break;
+
+            case OpCode::CallUser:
+            {
+                const UserFunction* func = lookup_user_func(*ctx.Session, op->Operand);
+                for (int i = 0; i < count; ++i)
+                    stack[top][i] = eval_user_func(func, stack[top][i], ctx);
+                if (ctx.Error)
+                {
+                    fill_nans(ys + base, n - base);
+                    return false;
+                }
+                break;
+            }
+
+            case OpCode::Negate:    lanes_negate(stack[top]);                   break;
+            case OpCode::Add:       lanes_add(stack[top-1], stack[top]); --top;       break;
+            case OpCode::Subtract:  lanes_subtract(stack[top-1], stack[top]); --top;  break;
+            case OpCode::Multiply:  lanes_multiply(stack[top-1], stack[top]); --top;  break;
+            case OpCode::Divide:    lanes_divide(stack[top-1], stack[top]); --top;    break;
+
+            case OpCode::Power:
+                for (int i = 0; i < count; ++i)
+                    stack[top-1][i] = std::pow(stack[top-1][i], stack[top][i]);
+                --top;
+                break;
+
+            case OpCode::Factorial:
+                for (int i = 0; i < count; ++i)
+                {
+                    if (!compute_factorial(stack[top][i]))
+                    {
+                        on_parse_error(ctx, "need a positive integer");
+                        fill_nans(ys + base, n - base);
+                        return false;
+                    }
+                }
+                break;
+
+            case OpCode::COUNT:
+                on_parse_error(ctx, "corrupt program");
+                fill_nans(ys + base, n - base);
+                return false;
+            }
+        }
+
+        for (int i = 0; i < count; ++i)
+            ys[base + i] = (top >= 0) ? stack[top][i] : 0.0;
+    }
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Interval run_program_interval(const Program& prog, const Interval* args, ParseCtx& ctx)
+{
+    Interval* stack = eval_stack(ctx).Frames[ctx.CallDepth].Bounds;
+    Interval* top = stack - 1;
+
+    const Op* op = prog.Ops;
+    const Op* opEnd = op + prog.NumOps;
+    for (; op != opEnd; ++op)
+    {
+        switch (op->Code)
+        {
+        case OpCode::Const:
+            ++top;
+            *top = make_interval(prog.Consts[op->Operand], prog.Consts[op->Operand]);
+            break;
+
+        case OpCode::LoadVar:
+        {
+            double val;
+            if (!eval_user_value(*ctx.Session, op->Operand, val))
+            {
+                on_unknown_name(ctx, "named val", op->Operand);
+                return kEntireInterval;
+            }
+            *(++top) = make_interval(val, val);
+            break;
+        }
+
+        case OpCode::LoadArg:
+            if (!args)
+            {
+                on_parse_error(ctx, "no args here");
+                return kEntireInterval;
+            }
+            *(++top) = args[op->Operand];
+            break;
+
+        case OpCode::CallBuiltin:
+            *top = call_builtin_function_interval(op->Operand, *top);
+            break;
+
+        case OpCode::CallUser:
+        {
+            const UserFunction* func = lookup_user_func(*ctx.Session, op->Operand);
+            if (!func)
+            {
+                on_unknown_name(ctx, "func", op->Operand);
+                return kEntireInterval;
+            }
+
+            *top = eval_user_func_interval(func, *top, ctx);
+            if (ctx.Error)
+                return kEntireInterval;
+            break;
+        }
+
+        case OpCode::Negate:    *top = interval_negate(*top);                       break;
+        case OpCode::Add:       top[-1] = interval_add(top[-1], top[0]); --top;         break;
+        case OpCode::Subtract:  top[-1] = interval_subtract(top[-1], top[0]); --top;    break;
+        case OpCode::Multiply:  top[-1] = interval_multiply(top[-1], top[0]); --top;    break;
+        case OpCode::Divide:    top[-1] = interval_divide(top[-1], top[0]); --top;      break;
+        case OpCode::Power:     top[-1] = interval_power(top[-1], top[0]); --top;       break;
+        case OpCode::Factorial: *top = interval_factorial(*top);                    break;
+
+        case OpCode::COUNT:
+            on_parse_error(ctx, "corrupt program");
+            return kEntireInterval;
+        }
+    }
+
+    if (top < stack)
+        return make_interval(0, 0);
+
+    return *top;
+}
+
+//-------------------------------------------------------------------------------------------------
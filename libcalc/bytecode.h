@@ -0,0 +1,111 @@
+#pragma once
+
+#include "interval.h"
+#include "parser.h"
+#include "platform.h"
+
+#include <cstdint>
+
+//-------------------------------------------------------------------------------------------------
+
+// expressions are compiled into a little stack-machine program, so user functions only get
+// tokenised/parsed once when they're defined rather than every time they're evaluated
+
+enum class OpCode : uint8_t
+{
+    Const,          // push Consts[Operand]
+    LoadVar,        // push the value of the user symbol with NameId Operand
+    LoadArg,        // push frame arg #Operand
+
+    CallBuiltin,    // top = builtin function #Operand (top)
+    CallUser,       // top = user function with NameId Operand (top)
+
+    Negate,
+    Add, Subtract,
+    Multiply, Divide,
+    Power,
+    Factorial,
+
+    COUNT,
+};
+
+struct Op
+{
+    OpCode Code;
+    uint8_t Operand;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+constexpr int kMaxProgramOps = 96;
+constexpr int kMaxProgramConsts = 24;
+constexpr int kMaxEvalStack = 16;
+
+// user functions can call each other this deep. there's no way to stop recursing, so anything
+// past a chain through every user function is runaway, eg. f(x) = f(x)
+constexpr int kMaxCallDepth = 10;
+
+// batches are evaluated this many xs at a time, with each op looping over all of them
+#if MLN_TARGET_PICO
+constexpr int kBatchLanes = 8;      // each lane costs a session 2 * (kMaxEvalStack+1) doubles
+#else
+constexpr int kBatchLanes = 64;
+#endif
+
+// the programs' working storage. it's far too big for the pico's stacks (2K on core 0, 4K on
+// core 1), so it lives in the session instead, one for each core that might be evaluating at
+// once (see ParseCtx::Stack)
+struct EvalStack
+{
+    // run_program and run_program_interval's stacks, one frame per level of user function call
+    // (a plain expression is level 0), so only the ops' bookkeeping goes on the real stack
+    union Frame
+    {
+        double Vals[kMaxEvalStack];
+        Interval Bounds[kMaxEvalStack];
+    };
+    Frame Frames[kMaxCallDepth + 1];
+
+    // run_program_batch's: a stack slot's worth of lanes for each slot, and the xs
+    // nb. a batch never runs another batch inside it, as user functions called from one are
+    // evaluated a lane at a time with run_program, so one per evaluation is enough
+    double Slots[kMaxEvalStack][kBatchLanes];
+    double Xs[kBatchLanes];
+};
+
+struct Program
+{
+    Op Ops[kMaxProgramOps];
+    double Consts[kMaxProgramConsts];
+
+    uint8_t NumOps = 0;
+    uint8_t NumConsts = 0;
+
+    uint8_t StackDepth = 0;     // only meaningful while compiling
+    uint8_t MaxStackDepth = 0;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+void program_reset(Program& prog);
+
+// these all report errors through ctx, and return false if the program has run out of space
+bool program_emit(Program& prog, OpCode code, ParseCtx& ctx, uint8_t operand = 0);
+bool program_emit_const(Program& prog, double val, ParseCtx& ctx);
+bool program_emit_named(Program& prog, OpCode code, NameId name, ParseCtx& ctx);
+
+// run a compiled program; runtime errors (unknown names etc) are reported through ctx
+// args is the frame for a user function call (null for a plain expression)
+double run_program(const Program& prog, const double* args, ParseCtx& ctx);
+
+// run prog once for each of xs[0..n) into ys, with frame arg 0 taking each x in turn
+// xs are read a batch of lanes ahead of the ys being written, so ys can be the same array
+// named values and functions are only looked up once per batch of lanes
+// on error, the remaining ys are set to nan
+bool run_program_batch(const Program& prog, const double* xs, double* ys, int n, ParseCtx& ctx);
+
+// run prog over intervals rather than numbers, giving bounds on its result for any frame args
+// inside args. runtime errors are reported through ctx as for run_program
+Interval run_program_interval(const Program& prog, const Interval* args, ParseCtx& ctx);
+
+//-------------------------------------------------------------------------------------------------
@@ -4,6 +4,10 @@
 #include "cmd.h"
 #include "expr.h"
 #include "maths.h"
+#include "session.h"
+
+#include <algorithm>
+#include <cstdio>
 
 //-------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------
@@ -36,6 +40,18 @@ struct DampedPendulumSystem
             z -= pi_real*2;
         x = clampRadsSym(x);
     }
+
+    // for rk4_step: dz/dt, dx/dt and dv/dt at a given point, and the biggest step that still
+    // gets the poincare section right
+    real_t phaseRate() const { return omega; }
+    void rates(real_t px, real_t pv, real_t pz, real_t& dx, real_t& dv) const
+    {
+        dx = pv;
+        dv = (-damp * pv) - sinf(px) + sinf(pz);
+    }
+    void wrap() { x = clampRadsSym(x); }
+    static constexpr real_t kMaxStep = 0.25;
+    static constexpr bool kSwitchesAtZeroX = false;
 };
 
 
@@ -65,6 +81,16 @@ struct ForcedVdPolOscillator
             z -= pi_real*2;
         x = clampRadsSym(x);
     }
+
+    real_t phaseRate() const { return omega; }
+    void rates(real_t px, real_t pv, real_t pz, real_t& dx, real_t& dv) const
+    {
+        dx = pv;
+        dv = (force * sinf(pz)) - px - ((px*px - 1) * pv);
+    }
+    void wrap() { x = clampRadsSym(x); }
+    static constexpr real_t kMaxStep = 0.25;
+    static constexpr bool kSwitchesAtZeroX = false;
 };
 
 
@@ -73,8 +99,11 @@ struct SignumSystem
     real_t x = 1;
     real_t v = 0.1;
     real_t z = 0;
+
+    // signum(x), held fixed between the crossings so rk4 only ever sees a smooth force
+    real_t side = 1;
     
-    void setParamA(double val)  { x = real_t(val); }
+    void setParamA(double val)  { x = real_t(val); side = signum(x); }
     void setParamB(double val)  { v = real_t(val); }
 
     real_t getX() const { return x * 0.6f; }
@@ -91,8 +120,140 @@ struct SignumSystem
         if (z > pi_real*2)
             z -= pi_real*2;
     }
+
+    real_t phaseRate() const { return 1; }
+    void rates(real_t, real_t pv, real_t pz, real_t& dx, real_t& dv) const
+    {
+        dx = pv;
+        dv = sinf(pz) - side;
+    }
+    void wrap() {}
+    // which way the force pushes now: it can only change as x crosses 0, and when x is right
+    // on it, it's the way x is heading that counts
+    void switchForce() { side = (x != 0) ? signum(x) : signum(v); }
+    static constexpr real_t kMaxStep = 0.02;     // it's chaotic in a thin layer, which bigger steps smear out
+    static constexpr bool kSwitchesAtZeroX = true;
 };
 
+//-------------------------------------------------------------------------------------------------
+
+// one classic 4th order runge-kutta step of h
+// the phase z goes up at a constant rate, so it doesn't need the full treatment
+template<typename SystemType>
+void rk4_step(SystemType& s, real_t h)
+{
+    const real_t hz = h * s.phaseRate();
+
+    real_t k1x, k1v, k2x, k2v, k3x, k3v, k4x, k4v;
+    s.rates(s.x, s.v, s.z, k1x, k1v);
+    s.rates(s.x + (h/2)*k1x, s.v + (h/2)*k1v, s.z + hz/2, k2x, k2v);
+    s.rates(s.x + (h/2)*k2x, s.v + (h/2)*k2v, s.z + hz/2, k3x, k3v);
+    s.rates(s.x + h*k3x, s.v + h*k3v, s.z + hz, k4x, k4v);
+
+    s.x += (h/6) * (k1x + 2*k2x + 2*k3x + k4x);
+    s.v += (h/6) * (k1v + 2*k2v + 2*k3v + k4v);
+    s.z += hz;
+    s.wrap();
+}
+
+// steps exactly onto x = 0, for a system whose force switches over there
+// this is henon's trick: with x standing in for time, d/dx of v and z is d/dt of them over
+// dx/dt, so one rk4 step of -x lands right on it; returns the time that took
+template<typename SystemType>
+real_t rk4_step_to_zero_x(SystemType& s)
+{
+    const real_t rate = s.phaseRate();
+    auto rates = [&s, rate](real_t px, real_t pv, real_t pz, real_t& dv, real_t& dz)
+    {
+        real_t dxdt, dvdt;
+        s.rates(px, pv, pz, dxdt, dvdt);
+        dv = dvdt / dxdt;
+        dz = rate / dxdt;
+    };
+
+    const real_t h = -s.x;
+
+    // x is the independent variable here, so each stage is at a known x, same as t usually is
+    real_t k1v, k1z, k2v, k2z, k3v, k3z, k4v, k4z;
+    rates(s.x, s.v, s.z, k1v, k1z);
+    rates(s.x + h/2, s.v + (h/2)*k1v, s.z + (h/2)*k1z, k2v, k2z);
+    rates(s.x + h/2, s.v + (h/2)*k2v, s.z + (h/2)*k2z, k3v, k3z);
+    rates(s.x + h, s.v + h*k3v, s.z + h*k3z, k4v, k4z);
+
+    const real_t dz = (h/6) * (k1z + 2*k2z + 2*k3z + k4z);
+    s.x = 0;
+    s.v += (h/6) * (k1v + 2*k2v + 2*k3v + k4v);
+    s.z += dz;
+
+    return dz / rate;
+}
+
+// one step of h for a system whose force switches as x crosses 0
+// rk4 relies on the force being smooth, so a step that crosses is redone in two parts either
+// side of the switch; returns the time actually run, which can be a little over h if the
+// crossing turns out to be just past the end of the step
+template<typename SystemType>
+real_t rk4_switched_step(SystemType& s, real_t h)
+{
+    const SystemType before = s;
+    rk4_step(s, h);
+    if ((s.x > 0) == (before.x > 0))
+        return h;
+
+    s = before;
+    const real_t dt = rk4_step_to_zero_x(s);
+
+    // grazing x = 0 with v close to 0 sends d/dx of everything off to infinity, so then it's
+    // better to just step over the switch than lose the rest of the section to a nan
+    if (!(dt >= 0 && dt <= 2*h) || !std::isfinite(s.v))
+    {
+        s = before;
+        rk4_step(s, h);
+        s.switchForce();
+        return h;
+    }
+
+    s.switchForce();
+    if (dt < h)
+    {
+        // if it's only just crossed, it can cross straight back (as it chatters along x = 0),
+        // and the force mustn't be left pushing from the wrong side
+        rk4_step(s, h - dt);
+        s.switchForce();
+    }
+
+    return std::max(dt, h);
+}
+
+// runs for time t, in steps of no more than SystemType::kMaxStep
+template<typename SystemType>
+void rk4_advance(SystemType& s, real_t t)
+{
+    const int steps = int(ceilf(t / SystemType::kMaxStep));
+    const real_t h = t / real_t(steps);
+
+    // time already run past the steps so far, which comes off the ones after
+    real_t over = 0;
+    for (int i = 0; i < steps; ++i)
+    {
+        if constexpr (SystemType::kSwitchesAtZeroX)
+        {
+            const real_t hLeft = h - over;
+            if (hLeft <= 0)
+            {
+                over -= h;
+                continue;
+            }
+
+            over = rk4_switched_step(s, hLeft) - hLeft;
+        }
+        else
+        {
+            rk4_step(s, h);
+        }
+    }
+}
+
 //-------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------
 
@@ -107,10 +268,14 @@ bool cmd_anim_diff(ParseCtx& ctx)
     if (!peek(ctx, Token::Eof))
         s.setParamB(parse_expression(ctx));
 
+    // smooth motion wants a decent frame rate
+    rndr.scheduleFrames(30, 10000);
+
     real_t step = 0.001;
     for (;;)
     {
-        for (int i = 0; i < 10000; ++i)
+        const int steps = rndr.beginFrame();
+        for (int i = 0; i < steps; ++i)
         {
             s.next(step);
 
@@ -123,8 +288,7 @@ bool cmd_anim_diff(ParseCtx& ctx)
             rndr.safePlot(xi, yi);
         }
     
-        rndr.blit();
-        rndr.darken();
+        rndr.endFrame(true);
 
         if (rndr.check_for_break())
             break;
@@ -138,46 +302,48 @@ bool cmd_anim_diff(ParseCtx& ctx)
 template<typename SystemType>
 bool cmd_anim_poincare(ParseCtx& ctx)
 {
-    AnimRenderer rndr(-3.5, 3.5, -4.5, 4.5);
-
     SystemType s;
     if (!peek(ctx, Token::Eof))
         s.setParamA(parse_expression(ctx));
     if (!peek(ctx, Token::Eof))
         s.setParamB(parse_expression(ctx));
 
-    real_t step = 0.01;
+    // the phase goes up steadily, so rather than watching for it to cross the slice, this
+    // steps straight onto it, and then round a whole cycle at a time
+    const real_t rate = s.phaseRate();
+    if (!(rate > 0))
+    {
+        on_parse_error(ctx, "the forcing has to go forwards");
+        return false;
+    }
+
     constexpr real_t slice = pi_real/2;
-    bool phiBelowSlice = s.getPhi() < slice;
+
+    if (s.getPhi() > slice)
+        s.z -= pi_real*2;
+    rk4_advance(s, (slice - s.getPhi()) / rate);
+
+    AnimRenderer rndr(-3.5, 3.5, -4.5, 4.5);
+
+    // the points build up over a few frames, and fade every 8, so a slower frame rate's fine
+    rndr.scheduleFrames(10, 320);
 
     for (int frame = 0; /**/; ++frame)
     {
-        for (int i = 0; i < 250000; ++i)
+        const int points = rndr.beginFrame();
+        for (int i = 0; i < points; ++i)
         {
-            s.next(step);
-
-            if (phiBelowSlice && s.getPhi() >= slice)
-            {
-                const real_t x = s.getX();
-                const real_t y = s.getY();
-
-                const real_t xi = rndr.x(x);
-                const real_t yi = rndr.y(y);
+            // the phase is left as it is, so if a cycle runs over, the next one's shorter
+            rk4_advance(s, ((slice + pi_real*2) - s.getPhi()) / rate);
+            s.z -= pi_real*2;
 
-                rndr.safePlot(xi, yi);
+            const real_t xi = rndr.x(s.getX());
+            const real_t yi = rndr.y(s.getY());
 
-                phiBelowSlice = false;
-            }
-            else if (!phiBelowSlice)
-            {
-                phiBelowSlice = (s.getPhi() < slice);
-            }
+            rndr.safePlot(xi, yi);
         }
 
-        rndr.blit();
-
-        if ((frame & 7) == 0)
-            rndr.darken();
+        rndr.endFrame((frame & 7) == 0);
 
         if (rndr.check_for_break())
             break;
@@ -188,14 +354,31 @@ bool cmd_anim_poincare(ParseCtx& ctx)
 
 //-------------------------------------------------------------------------------------------------
 
-void register_chaos_commands()
+bool cmd_anim_stats(ParseCtx& ctx)
+{
+    const CalcSession& session = *ctx.Session;
+    const AnimStats& stats = anim_get_stats();
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%u frames, %.1f fps\n", unsigned(stats.Frames), double(stats.Fps));
+    calc_puts(session, buf);
+    snprintf(buf, sizeof(buf), "%u steps/frame, %.0f steps/s\n", unsigned(stats.StepsPerFrame), double(stats.StepsPerSec));
+    calc_puts(session, buf);
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+void register_chaos_commands(CalcSession& session)
 {
-    register_calc_cmd(cmd_anim_diff<DampedPendulumSystem>, "dd", "d", "draw an animated diff eqn");
-    register_calc_cmd(cmd_anim_poincare<DampedPendulumSystem>, "pd", "p", "draw an animated poincare...\n slice of a diff eqn");
-    register_calc_cmd(cmd_anim_diff<ForcedVdPolOscillator>, "df", "d", "draw an animated diff eqn");
-    register_calc_cmd(cmd_anim_poincare<ForcedVdPolOscillator>, "pf", "p", "draw an animated poincare...\n slice of a diff eqn");
-    register_calc_cmd(cmd_anim_diff<SignumSystem>, "ds", "d", "draw an animated diff eqn");
-    register_calc_cmd(cmd_anim_poincare<SignumSystem>, "ps", "p", "draw an animated poincare...\n slice of a diff eqn");
+    register_calc_cmd(session, cmd_anim_diff<DampedPendulumSystem>, "dd", "d", "draw an animated diff eqn");
+    register_calc_cmd(session, cmd_anim_poincare<DampedPendulumSystem>, "pd", "p", "draw an animated poincare...\n slice of a diff eqn");
+    register_calc_cmd(session, cmd_anim_diff<ForcedVdPolOscillator>, "df", "d", "draw an animated diff eqn");
+    register_calc_cmd(session, cmd_anim_poincare<ForcedVdPolOscillator>, "pf", "p", "draw an animated poincare...\n slice of a diff eqn");
+    register_calc_cmd(session, cmd_anim_diff<SignumSystem>, "ds", "d", "draw an animated diff eqn");
+    register_calc_cmd(session, cmd_anim_poincare<SignumSystem>, "ps", "p", "draw an animated poincare...\n slice of a diff eqn");
+    register_calc_cmd(session, cmd_anim_stats, "as", "as", "how fast the last animation ran");
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -2,7 +2,11 @@
 
 //-------------------------------------------------------------------------------------------------
 
-void register_chaos_commands();
+struct CalcSession;
+
+//-------------------------------------------------------------------------------------------------
+
+void register_chaos_commands(CalcSession& session);
 
 //-------------------------------------------------------------------------------------------------
 
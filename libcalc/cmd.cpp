@@ -3,50 +3,48 @@
 #include "format.h"
 #include "funcs.h"
 #include "parser.h"
+#include "session.h"
 #include "symbols.h"
 
 #include <cstring>
 
 //-------------------------------------------------------------------------------------------------
 
-static CommandDef gCommands[kMaxCommands];
-static int gRegisteredCommands = 0;
-
-//-------------------------------------------------------------------------------------------------
-
 bool cmd_help(ParseCtx& ctx)
 {
+    CalcSession& session = *ctx.Session;
+
     if (peek(ctx, Token::Symbol))
     {
-        const CommandDef* cmd = lookup_command(ctx.TokenSymbol);
+        const CommandDef* cmd = lookup_command(session, ctx.TokenName);
         if (!cmd)
         {
             on_parse_error(ctx, "unknown help topic");
             return false;
         }
         
-        calc_puts(cmd->Help);
-        calc_puts("\n   ");
-        calc_puts(cmd->Usage);
-        calc_puts("\n");
+        calc_puts(session, cmd->Help);
+        calc_puts(session, "\n   ");
+        calc_puts(session, cmd->Usage);
+        calc_puts(session, "\n");
 
         return expect(ctx, Token::Symbol);
     }
 
-    calc_puts("Type expression, press Enter\n\n");
-    calc_puts("Define var / function with\n");
-    calc_puts(" <name>[<var>] = <expr in var>\n");
-    calc_puts("eg.  f[x] = sin(x^2)\n");
-    calc_puts("eg.  theta = 2pi/3\n");
-    calc_puts("\n([{ and }]) are interchangeable\n\n");
+    calc_puts(session, "Type expression, press Enter\n\n");
+    calc_puts(session, "Define var / function with\n");
+    calc_puts(session, " <name>[<var>] = <expr in var>\n");
+    calc_puts(session, "eg.  f[x] = sin(x^2)\n");
+    calc_puts(session, "eg.  theta = 2pi/3\n");
+    calc_puts(session, "\n([{ and }]) are interchangeable\n\n");
 
-    const CommandDef* cmd = gCommands;
-    for (int i=0; i<gRegisteredCommands; ++i, ++cmd)
+    const CommandDef* cmd = session.Commands.Commands;
+    for (int i=0; i<session.Commands.Count; ++i, ++cmd)
     {
-        calc_puts(cmd->Name);
-        calc_puts(" -- ");
-        calc_puts(cmd->Help);
-        calc_puts("\n");
+        calc_puts(session, cmd->Name);
+        calc_puts(session, " -- ");
+        calc_puts(session, cmd->Help);
+        calc_puts(session, "\n");
     }
 
     return true;
@@ -54,57 +52,59 @@ bool cmd_help(ParseCtx& ctx)
 
 //-------------------------------------------------------------------------------------------------
 
-bool cmd_list(const char*)
+bool cmd_list(ParseCtx& ctx)
 {
-    calc_puts("== builtin functions ==\n");
+    const CalcSession& session = *ctx.Session;
+
+    calc_puts(session, "== builtin functions ==\n");
 
     for (BuiltinFunctionIt it = function_builtin_begin();
         it;
         it = function_next(it))
     {
-        calc_puts(function_name(it));
-        calc_puts("\t");
+        calc_puts(session, function_name(it));
+        calc_puts(session, "\t");
     }
 
-    calc_puts("\n\n== builtin constants ==\n");
+    calc_puts(session, "\n\n== builtin constants ==\n");
     for (BuiltinSymbolIt it = symbol_builtin_begin();
         it;
         it = symbol_next(it))
     {
-        calc_puts(symbol_name(it));
-        calc_puts("\t");
+        calc_puts(session, symbol_name(it));
+        calc_puts(session, "\t");
     }
-    calc_puts("\n");
+    calc_puts(session, "\n");
 
-    if (UserFunctionIt it = function_user_begin())
+    if (UserFunctionIt it = function_user_begin(session))
     {
-        calc_puts("\n== user-defined functions ==\n");
+        calc_puts(session, "\n== user-defined functions ==\n");
 
-        for (; it; it = function_next(it))
+        for (; it; it = function_next(session, it))
         {
-            calc_puts("  ");
-            calc_puts(function_name(it));
-            calc_puts("(...) = ");
-            calc_puts(function_def(it));
-            calc_puts("\n");
+            calc_puts(session, "  ");
+            calc_puts(session, function_name(session, it));
+            calc_puts(session, "(...) = ");
+            calc_puts(session, function_def(it));
+            calc_puts(session, "\n");
         }
     }
 
-    if (UserSymbolIt it = symbol_user_begin())
+    if (UserSymbolIt it = symbol_user_begin(session))
     {
-        calc_puts("\n== user-defined symbols ==\n");
+        calc_puts(session, "\n== user-defined symbols ==\n");
 
-        for (; it; it = symbol_next(it))
+        for (; it; it = symbol_next(session, it))
         {
             char val_str[32];
             dtostr_human(symbol_val(it), val_str, sizeof(val_str));
             val_str[sizeof(val_str)-1] = 0;
 
-            calc_puts("  ");
-            calc_puts(symbol_name(it));
-            calc_puts(" = ");
-            calc_puts(val_str);
-            calc_puts("\n");
+            calc_puts(session, "  ");
+            calc_puts(session, symbol_name(session, it));
+            calc_puts(session, " = ");
+            calc_puts(session, val_str);
+            calc_puts(session, "\n");
         }
     }
 
@@ -113,58 +113,82 @@ bool cmd_list(const char*)
 
 //-------------------------------------------------------------------------------------------------
 
-void init_commands()
+void init_commands(CalcSession& session)
 {
-    gRegisteredCommands = 0;
+    session.Commands = CommandTable {};
 
-    register_calc_cmd(cmd_help, "help", "help [command]", "shows help");
-    register_calc_cmd(cmd_list, "list", "list", "lists definitions");
+    register_calc_cmd(session, cmd_help, "help", "help [command]", "shows help");
+    register_calc_cmd(session, cmd_list, "list", "list", "lists definitions");
 }
 
 //-------------------------------------------------------------------------------------------------
 
-void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage, const char* help)
+static CommandDef* alloc_command(CalcSession& session, const char* name, const char* usage, const char* help)
 {
-    if (gRegisteredCommands >= kMaxCommands)
-        return;
+    CommandTable& cmds = session.Commands;
+    if (cmds.Count >= kMaxCommands)
+        return nullptr;
+
+    const NameId nameId = intern_name(session.Names, name);
+    if (nameId == kInvalidName)
+        return nullptr;
 
-    CommandDef* cmd = gCommands + gRegisteredCommands;
+    CommandDef* cmd = cmds.Commands + cmds.Count;
     cmd->Name = name;
     cmd->Usage = usage;
     cmd->Help = help;
+
+    ++cmds.Count;
+    cmds.ByName[nameId] = uint8_t(cmds.Count);
+
+    return cmd;
+}
+
+void register_calc_cmd(CalcSession& session, calc_cmd_func func, const char* name, const char* usage, const char* help)
+{
+    CommandDef* cmd = alloc_command(session, name, usage, help);
+    if (!cmd)
+        return;
+
     cmd->Func = func;
     cmd->PFunc = nullptr;
-
-    ++gRegisteredCommands;
 }
 
-void register_calc_cmd(calc_cmd_parser_func func, const char* name, const char* usage, const char* help)
+void register_calc_cmd(CalcSession& session, calc_cmd_parser_func func, const char* name, const char* usage, const char* help)
 {
-    if (gRegisteredCommands >= kMaxCommands)
+    CommandDef* cmd = alloc_command(session, name, usage, help);
+    if (!cmd)
         return;
 
-    CommandDef* cmd = gCommands + gRegisteredCommands;
-    cmd->Name = name;
-    cmd->Usage = usage;
-    cmd->Help = help;
     cmd->Func = nullptr;
     cmd->PFunc = func;
+}
 
-    ++gRegisteredCommands;
+void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage, const char* help)
+{
+    register_calc_cmd(*calc_default_session(), func, name, usage, help);
+}
+
+void calc_session_register_cmd(CalcSession* session, calc_cmd_func func, const char* name, const char* usage, const char* help)
+{
+    if (session)
+        register_calc_cmd(*session, func, name, usage, help);
 }
 
 //-------------------------------------------------------------------------------------------------
 
-const CommandDef* lookup_command(const char* name)
+const CommandDef* lookup_command(const CalcSession& session, NameId name)
 {
-    const CommandDef* cmd = gCommands;
-    for (int i=0; i<gRegisteredCommands; ++i, ++cmd)
-    {
-        if (strcmp(cmd->Name, name) == 0)
-            return cmd;
-    }
+    const CommandTable& cmds = session.Commands;
+    if (name >= kMaxNames || !cmds.ByName[name])
+        return nullptr;
 
-    return nullptr;
+    return &cmds.Commands[cmds.ByName[name] - 1];
+}
+
+const CommandDef* lookup_command(const CalcSession& session, const char* name)
+{
+    return lookup_command(session, find_name(session.Names, name));
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "libcalc.h"
+#include "names.h"
 
 //-------------------------------------------------------------------------------------------------
 
+struct CalcSession;
 struct ParseCtx;
 
 //-------------------------------------------------------------------------------------------------
@@ -21,14 +23,26 @@ struct CommandDef
     calc_cmd_parser_func* PFunc = nullptr;
 };
 
+struct CommandTable
+{
+    CommandDef Commands[kMaxCommands];
+    int Count = 0;
+
+    // 1 + the index into Commands for each interned name, or 0 if it's not a command
+    uint8_t ByName[kMaxNames] = {0};
+};
+static_assert(kMaxCommands < 255);
+
 //-------------------------------------------------------------------------------------------------
 
-void init_commands();
+// resets session's commands to just the core ones
+void init_commands(CalcSession& session);
 
-void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage, const char* help);
-void register_calc_cmd(calc_cmd_parser_func func, const char* name, const char* usage, const char* help);
+void register_calc_cmd(CalcSession& session, calc_cmd_func func, const char* name, const char* usage, const char* help);
+void register_calc_cmd(CalcSession& session, calc_cmd_parser_func func, const char* name, const char* usage, const char* help);
 
-const CommandDef* lookup_command(const char* name);
+const CommandDef* lookup_command(const CalcSession& session, NameId name);
+const CommandDef* lookup_command(const CalcSession& session, const char* name);
 
 //-------------------------------------------------------------------------------------------------
 
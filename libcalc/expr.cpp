@@ -1,8 +1,10 @@
 #include "expr.h"
 
+#include "bytecode.h"
 #include "funcs.h"
 #include "maths.h"
 #include "parser.h"
+#include "session.h"
 #include "symbols.h"
 
 #include <cmath>
@@ -11,120 +13,167 @@
 
 //-------------------------------------------------------------------------------------------------
 
+// the grammar below emits bytecode rather than evaluating as it goes; parse_expression just
+// compiles into a scratch program and runs it straight away
+
+struct CompileCtx
+{
+    ParseCtx& Parse;
+    Program& Prog;
+
+    // function definitions may refer to things that don't exist yet, so only check names
+    // up front when we're going to run the expression immediately
+    bool Deferred;
+
+    // the function parameter, which lives in frame slot 0 rather than in the symbol table
+    NameId Arg = kInvalidName;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+static void compile_expression(CompileCtx& cc);
+
 // primary = number | "(" expression ")"
-double parse_primary(ParseCtx& ctx)
+static void compile_primary(CompileCtx& cc)
 {
+    ParseCtx& ctx = cc.Parse;
+
     if (accept(ctx, Token::LParen))
     {
-        double val = parse_expression(ctx);
+        compile_expression(cc);
         expect(ctx, Token::RParen);
-        return val;
+        return;
     }
 
     if (accept(ctx, Token::Minus))
     {
-        return -expect_number(ctx);
+        const double val = expect_number(ctx);
+        program_emit_const(cc.Prog, -val, ctx);
+        return;
     }
 
-    return expect_number(ctx);
+    const double val = expect_number(ctx);
+    program_emit_const(cc.Prog, val, ctx);
 }
 
 // postfix ::= primary | primary "!" | symbol "(" expression ")" | symbol
-double parse_postfix(ParseCtx& ctx)
+static void compile_postfix(CompileCtx& cc)
 {
+    ParseCtx& ctx = cc.Parse;
     char errBuf[20+kMaxSymbolLength+1];
 
-    double val = 1.0 / 0.0;
     if (peek(ctx, Token::Symbol))
     {
         const int sym_name_pos = ctx.CurrIx;
 
-        char symbol[kMaxSymbolLength];
+        char symbol[kMaxSymbolLength+1];
         strcpy(symbol, ctx.TokenSymbol);
+        const uint32_t hash = ctx.TokenHash;
+        NameId name = ctx.TokenName;
         expect(ctx, Token::Symbol);
 
+        // deferred programs can name things nobody has defined yet, so they need an id now
+        if (cc.Deferred && name == kInvalidName)
+            name = intern_name(ctx.Session->Names, hash, symbol);
+
         // if this is a (, we have a fn call. else it's a named value
         if (accept(ctx, Token::LParen))
         {
-            double arg1 = parse_expression(ctx);
+            compile_expression(cc);
             if (!expect(ctx, Token::RParen))
-                return 0.0;
+                return;
 
-            if (!eval_function(symbol, arg1, val, ctx))
+            const int builtin = find_builtin_function(hash, symbol);
+            if (builtin >= 0)
+            {
+                program_emit(cc.Prog, OpCode::CallBuiltin, ctx, uint8_t(builtin));
+            }
+            else if (cc.Deferred || is_user_func(*ctx.Session, name))
+            {
+                program_emit_named(cc.Prog, OpCode::CallUser, name, ctx);
+            }
+            else
             {
-                if (ctx.Error)
-                    return 0.0;
-
                 ctx.CurrIx = sym_name_pos;
                 sprintf(errBuf, "unknown func: %s", symbol);
                 on_parse_error(ctx, errBuf);
-                return 0.0;
+                return;
             }
         }
         else
         {
-            if (!eval_named_value(symbol, val))
+            // builtin constants can't be redefined, so fold them in now
+            double val;
+            if (name != kInvalidName && name == cc.Arg)
+            {
+                program_emit(cc.Prog, OpCode::LoadArg, ctx, 0);
+            }
+            else if (eval_builtin_value(hash, symbol, val))
+            {
+                program_emit_const(cc.Prog, val, ctx);
+            }
+            else if (cc.Deferred || eval_user_value(*ctx.Session, name, val))
+            {
+                program_emit_named(cc.Prog, OpCode::LoadVar, name, ctx);
+            }
+            else
             {
                 ctx.CurrIx = sym_name_pos;
                 sprintf(errBuf, "unknown named val: %s", symbol);
                 on_parse_error(ctx, errBuf);
-                return 0.0;
+                return;
             }
         }
     }
     else
     {
-        val = parse_primary(ctx);
+        compile_primary(cc);
     }
 
     if (accept(ctx, Token::Factorial))
-    {
-        if (!compute_factorial(val))
-        {
-            on_parse_error(ctx, "need a positive integer");
-            return 0.0;
-        }
-    }
-
-    return val;
+        program_emit(cc.Prog, OpCode::Factorial, ctx);
 }
 
 // exponent ::= postfix [ "**" postfix ]
-double parse_exponent(ParseCtx& ctx)
+static void compile_exponent(CompileCtx& cc)
 {
-    double val = parse_postfix(ctx);
-    if (ctx.Error)
-        return 0;
+    compile_postfix(cc);
+    if (cc.Parse.Error)
+        return;
 
-    if (accept(ctx, Token::Exponent))
+    if (accept(cc.Parse, Token::Exponent))
     {
-        double power = parse_postfix(ctx);
-        if (ctx.Error)
-            return 0;
-
-        val = std::pow(val, power);
+        compile_postfix(cc);
+        program_emit(cc.Prog, OpCode::Power, cc.Parse);
     }
-
-    return val;
 }
 
 // unary = exponent | "+" unary | "-" unary
-double parse_unary(ParseCtx& ctx)
+static void compile_unary(CompileCtx& cc)
 {
-    if (accept(ctx, Token::Plus))
-        return parse_unary(ctx);
-    if (accept(ctx, Token::Minus))
-        return -1.0 * parse_unary(ctx);
+    if (accept(cc.Parse, Token::Plus))
+    {
+        compile_unary(cc);
+        return;
+    }
+    if (accept(cc.Parse, Token::Minus))
+    {
+        compile_unary(cc);
+        program_emit(cc.Prog, OpCode::Negate, cc.Parse);
+        return;
+    }
 
-    return parse_exponent(ctx);
+    compile_exponent(cc);
 }
 
 // mul ::= unary | mul "*" unary | mul "/" unary | unary mul
-double parse_mul(ParseCtx& ctx)
+static void compile_mul(CompileCtx& cc)
 {
+    ParseCtx& ctx = cc.Parse;
+
     bool allowed_implicit_mul = peek(ctx, Token::Number) || peek(ctx, Token::LParen);
 
-    double val = parse_unary(ctx);
+    compile_unary(cc);
 
     bool had_infix = false;
     while (!ctx.Error && (peek(ctx, Token::Times) || peek(ctx, Token::Divide)))
@@ -133,11 +182,13 @@ double parse_mul(ParseCtx& ctx)
 
         if (accept(ctx, Token::Times))
         {
-            val = val * parse_unary(ctx);
+            compile_unary(cc);
+            program_emit(cc.Prog, OpCode::Multiply, ctx);
         }
         else if (accept(ctx, Token::Divide))
         {
-            val = val / parse_unary(ctx);
+            compile_unary(cc);
+            program_emit(cc.Prog, OpCode::Divide, ctx);
         }
     }
 
@@ -146,38 +197,72 @@ double parse_mul(ParseCtx& ctx)
     {
         if (peek(ctx, Token::Symbol) || peek(ctx, Token::LParen))
         {
-            val *= parse_mul(ctx);
+            compile_mul(cc);
+            program_emit(cc.Prog, OpCode::Multiply, ctx);
         }
     }
-
-    return val;
 }
 
 // add ::= mul | add "+" mul | add "-" mul
-double parse_add(ParseCtx& ctx)
+static void compile_add(CompileCtx& cc)
 {
-    double val = parse_mul(ctx);
+    ParseCtx& ctx = cc.Parse;
+
+    compile_mul(cc);
 
     while (!ctx.Error && (peek(ctx, Token::Plus) || peek(ctx, Token::Minus)))
     {
         if (accept(ctx, Token::Plus))
         {
-            val = val + parse_mul(ctx);
+            compile_mul(cc);
+            program_emit(cc.Prog, OpCode::Add, ctx);
         }
         else if (accept(ctx, Token::Minus))
         {
-            val = val - parse_mul(ctx);
+            compile_mul(cc);
+            program_emit(cc.Prog, OpCode::Subtract, ctx);
         }
     }
+}
 
-    return val;
+static void compile_expression(CompileCtx& cc)
+{
+    compile_add(cc);
 }
 
+//-------------------------------------------------------------------------------------------------
+
+bool compile_expression(ParseCtx& ctx, Program& prog, bool deferred)
+{
+    program_reset(prog);
+    if (ctx.Error)
+        return false;
+
+    CompileCtx cc { .Parse = ctx, .Prog = prog, .Deferred = deferred };
+    compile_expression(cc);
+
+    return !ctx.Error;
+}
+
+bool compile_function(ParseCtx& ctx, Program& prog, NameId arg)
+{
+    program_reset(prog);
+    if (ctx.Error)
+        return false;
+
+    CompileCtx cc { .Parse = ctx, .Prog = prog, .Deferred = true, .Arg = arg };
+    compile_expression(cc);
+
+    return !ctx.Error;
+}
 
 double parse_expression(ParseCtx& ctx)
 {
-    return parse_add(ctx);
+    Program& prog = ctx.Session->Scratch;
+    if (!compile_expression(ctx, prog, false))
+        return 0.0;
+
+    return run_program(prog, nullptr, ctx);
 }
 
 //-------------------------------------------------------------------------------------------------
-
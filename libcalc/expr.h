@@ -1,12 +1,22 @@
 #pragma once
 
+#include "names.h"
+
 //-------------------------------------------------------------------------------------------------
 
 struct ParseCtx;
+struct Program;
 
 //-------------------------------------------------------------------------------------------------
 
 double parse_expression(ParseCtx& ctx);
 
-//-------------------------------------------------------------------------------------------------
+// compile the expression at the current token into prog rather than evaluating it
+// if deferred, names don't need to be defined until the program is run
+bool compile_expression(ParseCtx& ctx, Program& prog, bool deferred);
 
+// compile a user function body; references to arg read the call's frame rather than a symbol,
+// and everything else is deferred
+bool compile_function(ParseCtx& ctx, Program& prog, NameId arg);
+
+//-------------------------------------------------------------------------------------------------
@@ -5,45 +5,80 @@
 
 //----------------------------------------------------------------------------------------
 
-GlyphMetric font_get_glyph_metric(const Font* font, char c, bool monospace)
+// the proportional spacing for each font, worked out at compile time
+// nb. these need to match the fonts' widths
+
+static constexpr GlyphMetric metric_10x16(char c)
 {
-    const uint8_t glyphWidth = font->Width;
+    constexpr uint8_t glyphWidth = 10;
+
+    if (c == ' ')
+        return { .Skip = 0, .Advance = uint8_t(glyphWidth - 2) };
+    if (c == '\'' || c == '.' || c == ',')
+        return { .Skip = 3, .Advance = uint8_t(glyphWidth - 7) };
+    if (c == ';' || c == ':')
+        return { .Skip = 2, .Advance = uint8_t(glyphWidth - 5) };
+    if (c == 'i')
+        return { .Skip = 1, .Advance = uint8_t(glyphWidth - 4) };
+    if (c == 'l' || c == '1')
+        return { .Skip = 2, .Advance = uint8_t(glyphWidth - 4) };
+    if (c == 'f' || c == 't' || c == '^')
+        return { .Skip = 1, .Advance = uint8_t(glyphWidth - 2) };
+    if (c == 'r')
+        return { .Skip = 0, .Advance = uint8_t(glyphWidth - 1) };
+    if (c == 'k')
+        return { .Skip = 0, .Advance = uint8_t(glyphWidth - 2) };
 
-    if (monospace)
-        return { .Skip = 0, .Advance = glyphWidth };
+    return { .Skip = 0, .Advance = glyphWidth };
+}
 
-    if (font == &font_10x16)
-    {
-        if (c == ' ')
-            return { .Skip = 0, .Advance = uint8_t(glyphWidth - 2) };
-        if (c == '\'' || c == '.' || c == ',')
-            return { .Skip = 3, .Advance = uint8_t(glyphWidth - 7) };
-        if (c == ';' || c == ':')
-            return { .Skip = 2, .Advance = uint8_t(glyphWidth - 5) };
-        if (c == 'i')
-            return { .Skip = 1, .Advance = uint8_t(glyphWidth - 4) };
-        if (c == 'l' || c == '1')
-            return { .Skip = 2, .Advance = uint8_t(glyphWidth - 4) };
-        if (c == 'f' || c == 't' || c == '^')
-            return { .Skip = 1, .Advance = uint8_t(glyphWidth - 2) };
-        if (c == 'r')
-            return { .Skip = 0, .Advance = uint8_t(glyphWidth - 1) };
-        if (c == 'k')
-            return { .Skip = 0, .Advance = uint8_t(glyphWidth - 2) };
-    }
-    else if (font == &font_5x10)
-    {
-        if (c == ' ')
-            return { .Skip = 0, .Advance = uint8_t(glyphWidth - 1) };
-        if (c == 'm' || c == '/' || c == 'w' || c == 'v' || c == 'W' || c == 'V' || c == 'x')
-            return { .Skip = 0, .Advance = uint8_t(glyphWidth + 1) };
-        if (c == 'l' || c == 'I' || c == '1' || c == 'i')
-            return { .Skip = 1, .Advance = uint8_t(glyphWidth - 1) };
-    }
+static constexpr GlyphMetric metric_5x10(char c)
+{
+    constexpr uint8_t glyphWidth = 5;
+
+    if (c == ' ')
+        return { .Skip = 0, .Advance = uint8_t(glyphWidth - 1) };
+    if (c == 'm' || c == '/' || c == 'w' || c == 'v' || c == 'W' || c == 'V' || c == 'x')
+        return { .Skip = 0, .Advance = uint8_t(glyphWidth + 1) };
+    if (c == 'l' || c == 'I' || c == '1' || c == 'i')
+        return { .Skip = 1, .Advance = uint8_t(glyphWidth - 1) };
 
     return { .Skip = 0, .Advance = glyphWidth };
 }
 
+constexpr int kNumMetrics = 128;
+
+struct MetricTable
+{
+    GlyphMetric Metrics[kNumMetrics];
+};
+
+template<typename MetricFn>
+static constexpr MetricTable make_metric_table(MetricFn fn)
+{
+    MetricTable table {};
+    for (int c = 0; c < kNumMetrics; ++c)
+        table.Metrics[c] = fn(char(c));
+    return table;
+}
+
+static constexpr MetricTable kMetrics10x16 = make_metric_table(metric_10x16);
+static constexpr MetricTable kMetrics5x10 = make_metric_table(metric_5x10);
+
+GlyphMetric font_get_glyph_metric(const Font* font, char c, bool monospace)
+{
+    const uint8_t ix = uint8_t(c);
+    if (monospace || ix >= kNumMetrics)
+        return { .Skip = 0, .Advance = font->Width };
+
+    if (font == &font_10x16)
+        return kMetrics10x16.Metrics[ix];
+    if (font == &font_5x10)
+        return kMetrics5x10.Metrics[ix];
+
+    return { .Skip = 0, .Advance = font->Width };
+}
+
 //----------------------------------------------------------------------------------------
 
 void font_rasterise_char(
@@ -100,3 +135,79 @@ void font_rasterise_char(
 
 //----------------------------------------------------------------------------------------
 
+// the most recently used glyphs, expanded and trimmed
+// most of what a calculator prints is the same few characters in the same colours
+constexpr int kGlyphCacheSize = 32;
+
+struct CachedGlyph
+{
+    const Font* FontPtr;
+    char Char;
+    bool Monospace;
+    uint16_t FgCol;
+    uint16_t BgCol;
+    GlyphMetric Metric;
+    uint32_t LastUsed;      // 0 if the slot's empty
+    uint16_t Pixels[FONT_MAX_WIDTH * FONT_MAX_HEIGHT];
+};
+
+static CachedGlyph gGlyphCache[kGlyphCacheSize];
+static uint32_t gGlyphCacheClock = 0;
+
+static void expand_glyph(CachedGlyph& glyph)
+{
+    const int glyphWidth = glyph.FontPtr->Width;
+    const int glyphHeight = glyph.FontPtr->Height;
+
+    uint16_t full[FONT_MAX_WIDTH * FONT_MAX_HEIGHT];
+    font_rasterise_char(glyph.FontPtr, glyph.Char, glyph.FgCol, glyph.BgCol, full, glyphWidth, glyphHeight, 0, 0);
+
+    // keep the Advance columns from Skip onwards, padding with the background if that runs
+    // past the glyph
+    const int advance = glyph.Metric.Advance;
+    const int skip = glyph.Metric.Skip;
+    const int copyWidth = std::min(glyphWidth - skip, advance);
+
+    uint16_t* dest = glyph.Pixels;
+    const uint16_t* src = full + skip;
+    for (int row = 0; row < glyphHeight; ++row, dest += advance, src += glyphWidth)
+    {
+        std::copy(src, src + copyWidth, dest);
+        std::fill(dest + copyWidth, dest + advance, glyph.BgCol);
+    }
+}
+
+const uint16_t* font_get_glyph(const Font* font, char c, uint16_t fgcol, uint16_t bgcol, bool monospace, GlyphMetric* metric)
+{
+    ++gGlyphCacheClock;
+
+    CachedGlyph* oldest = &gGlyphCache[0];
+    for (CachedGlyph& glyph : gGlyphCache)
+    {
+        if (glyph.LastUsed && glyph.Char == c && glyph.FontPtr == font && glyph.FgCol == fgcol
+            && glyph.BgCol == bgcol && glyph.Monospace == monospace)
+        {
+            glyph.LastUsed = gGlyphCacheClock;
+            *metric = glyph.Metric;
+            return glyph.Pixels;
+        }
+
+        if (glyph.LastUsed < oldest->LastUsed)
+            oldest = &glyph;
+    }
+
+    CachedGlyph& glyph = *oldest;
+    glyph.FontPtr = font;
+    glyph.Char = c;
+    glyph.Monospace = monospace;
+    glyph.FgCol = fgcol;
+    glyph.BgCol = bgcol;
+    glyph.Metric = font_get_glyph_metric(font, c, monospace);
+    glyph.LastUsed = gGlyphCacheClock;
+    expand_glyph(glyph);
+
+    *metric = glyph.Metric;
+    return glyph.Pixels;
+}
+
+//----------------------------------------------------------------------------------------
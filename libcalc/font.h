@@ -43,6 +43,11 @@ void font_rasterise_char(
     int x,
     int y);
 
+// a glyph expanded to RGB565 and trimmed to its metric, so it's metric->Advance pixels wide
+// (and rows are that far apart) and the font's height
+// glyphs come from a small cache, so the pixels are only good until the next call
+const uint16_t* font_get_glyph(const Font* font, char c, uint16_t fgcol, uint16_t bgcol, bool monospace, GlyphMetric* metric);
+
 extern const Font font_5x10;
 extern const Font font_10x16;
 
@@ -1,8 +1,10 @@
 #include "funcs.h"
 
+#include "bytecode.h"
 #include "expr.h"
 #include "maths.h"
 #include "parser.h"
+#include "session.h"
 #include "symbols.h"
 
 #include <cmath>
@@ -10,12 +12,8 @@
 
 //-----------------------------------------------------------------------------------------------
 
-constexpr int kMaxFuncDefLen = 255;
-constexpr int kMaxUserFuncs = 10;
-
-//-----------------------------------------------------------------------------------------------
-
 typedef double (*CalcDoubleFn)(double);
+typedef Interval (*CalcIntervalFn)(Interval);
 
 // a function is defined strictly as taking zero or more args and returning a single value
 // TODO: allow complex/fractional/vector/matrix return vals
@@ -24,110 +22,154 @@ struct FunctionDef
     const char* Name = nullptr;
     const char* Args = "d";
     CalcDoubleFn FuncPtr = nullptr;
-};
-
-struct UserFunction
-{
-    char Name[kMaxSymbolLength+1] = {0};
-    char Arg[kMaxSymbolLength+1] = {0};
-
-    char Def[kMaxFuncDefLen+1] = {0};
-
-    bool IsUsed = false;
+    CalcIntervalFn IntervalPtr = nullptr;   // bounds FuncPtr over a range of args
 };
 
 //-----------------------------------------------------------------------------------------------
 
-FunctionDef gFunctions[] =
+constexpr FunctionDef gFunctions[] =
 {
-    { .Name = "sin", .FuncPtr = (CalcDoubleFn)sin },
-    { .Name = "cos", .FuncPtr = (CalcDoubleFn)cos },
-    { .Name = "tan", .FuncPtr = (CalcDoubleFn)tan },
-    { .Name = "sinc", .FuncPtr = (CalcDoubleFn)sinc },
-
-    { .Name = "asin", .FuncPtr = (CalcDoubleFn)asin },
-    { .Name = "acos", .FuncPtr = (CalcDoubleFn)acos },
-    { .Name = "atan", .FuncPtr = (CalcDoubleFn)atan },
-
-    { .Name = "ln", .FuncPtr = (CalcDoubleFn)log },
-    { .Name = "log", .FuncPtr = (CalcDoubleFn)log10 },
-    { .Name = "sqrt", .FuncPtr = (CalcDoubleFn)sqrt },
+    { .Name = "sin", .FuncPtr = (CalcDoubleFn)sin, .IntervalPtr = interval_sin },
+    { .Name = "cos", .FuncPtr = (CalcDoubleFn)cos, .IntervalPtr = interval_cos },
+    { .Name = "tan", .FuncPtr = (CalcDoubleFn)tan, .IntervalPtr = interval_tan },
+    { .Name = "sinc", .FuncPtr = (CalcDoubleFn)sinc, .IntervalPtr = interval_sinc },
+
+    { .Name = "asin", .FuncPtr = (CalcDoubleFn)asin, .IntervalPtr = interval_asin },
+    { .Name = "acos", .FuncPtr = (CalcDoubleFn)acos, .IntervalPtr = interval_acos },
+    { .Name = "atan", .FuncPtr = (CalcDoubleFn)atan, .IntervalPtr = interval_atan },
+
+    { .Name = "ln", .FuncPtr = (CalcDoubleFn)log, .IntervalPtr = interval_ln },
+    { .Name = "log", .FuncPtr = (CalcDoubleFn)log10, .IntervalPtr = interval_log10 },
+    { .Name = "sqrt", .FuncPtr = (CalcDoubleFn)sqrt, .IntervalPtr = interval_sqrt },
 };
 constexpr int kNumFunctions = sizeof(gFunctions) / sizeof(gFunctions[0]);
-
-
-UserFunction gUserFuncs[kMaxUserFuncs];
+constexpr NameHashIndex<16> kFunctionIndex = build_name_index<16>(gFunctions);
 
 //-----------------------------------------------------------------------------------------------
 
-static UserFunction* find_or_alloc_userfunc(const char* name)
+static UserFunction* find_or_alloc_userfunc(FunctionTable& funcs, NameId name)
 {
-    UserFunction* free_func = nullptr;
+    if (funcs.ByName[name])
+        return &funcs.Funcs[funcs.ByName[name] - 1];
 
-    for (UserFunction& func : gUserFuncs)
+    for (int ix = 0; ix < kMaxUserFuncs; ++ix)
     {
-        if (!func.IsUsed)
-        {
-            if (!free_func)
-                free_func = &func;
+        UserFunction& func = funcs.Funcs[ix];
+        if (func.IsUsed)
             continue;
-        }
 
-        if (strcmp(name, func.Name) == 0)
-            return &func;
+        func.Name = name;
+        func.IsUsed = true;
+        funcs.ByName[name] = uint8_t(ix + 1);
+        return &func;
     }
 
-    if (free_func)
+    return nullptr;
+}
+
+// interns the names and compiles the body into funcs.CompileScratch, returning the function
+// it's going to replace (or a free one), or null on error
+static UserFunction* compile_definition(const char* name, const char* arg, NameId& outArgId, ParseCtx& ctx)
+{
+    CalcSession& session = *ctx.Session;
+    FunctionTable& funcs = session.Functions;
+
+    const NameId nameId = intern_name(session.Names, name);
+    outArgId = intern_name(session.Names, arg);
+    if (nameId == kInvalidName || outArgId == kInvalidName)
     {
-        strcpy(free_func->Name, name);
-        free_func->IsUsed = true;
-        return free_func;
+        on_parse_error(ctx, "too many names");
+        return nullptr;
     }
 
-    return nullptr;
+    advance_token(ctx);
+    if (!compile_function(ctx, funcs.CompileScratch, outArgId))
+        return nullptr;
+
+    if (!accept(ctx, Token::Eof))
+    {
+        on_parse_error(ctx, "trailing nonsense");
+        return nullptr;
+    }
+
+    UserFunction* func = find_or_alloc_userfunc(funcs, nameId);
+    if (!func)
+        on_parse_error(ctx, "too many user funcs");
+
+    return func;
 }
 
 bool define_function(const char* name, const char* arg, ParseCtx& ctx)
 {
-    UserFunction* func = find_or_alloc_userfunc(name);
-    if (!func)
+    if (strlen(ctx.InBuffer) > kMaxFuncDefLen)
     {
-        on_parse_error(ctx, "too many user funcs");
+        on_parse_error(ctx, "function def too long");
         return false;
     }
 
-    strcpy(func->Arg, arg);
+    double unused;
+    if (eval_builtin_value(arg, unused))
+    {
+        on_parse_error(ctx, "can't redefine a constant");
+        return false;
+    }
 
-    if (strlen(ctx.InBuffer) > kMaxFuncDefLen)
+    CalcSession& session = *ctx.Session;
+
+    // if it doesn't work out, nothing refers to the names it interned, including any the body
+    // deferred, so they go again
+    const int namesMark = session.Names.Count;
+    NameId argId = kInvalidName;
+    UserFunction* func = compile_definition(name, arg, argId, ctx);
+    if (!func)
     {
-        on_parse_error(ctx, "function def too long");
+        forget_names_since(session.Names, namesMark);
         return false;
     }
 
+    func->Arg = argId;
     strcpy(func->Def, ctx.InBuffer);
+    func->Code = session.Functions.CompileScratch;
     return true;
 }
 
 //-----------------------------------------------------------------------------------------------
 
+int find_builtin_function(uint32_t hash, const char* name)
+{
+    return find_in_name_index(kFunctionIndex, gFunctions, hash, name);
+}
+
+int find_builtin_function(const char* name)
+{
+    return find_builtin_function(hash_name(name), name);
+}
+
+double call_builtin_function(int ix, double arg1)
+{
+    return gFunctions[ix].FuncPtr(arg1);
+}
+
+Interval call_builtin_function_interval(int ix, Interval arg1)
+{
+    return gFunctions[ix].IntervalPtr(arg1);
+}
+
 bool eval_function(const char* name, double arg1, double& outVal, ParseCtx& ctx)
 {
-    for (const FunctionDef& func : gFunctions)
+    const uint32_t hash = hash_name(name);
+    const int builtin = find_builtin_function(hash, name);
+    if (builtin >= 0)
     {
-        if (strcmp(func.Name, name) == 0)
-        {
-            outVal = func.FuncPtr(arg1);
-            return true;
-        }
+        outVal = call_builtin_function(builtin, arg1);
+        return true;
     }
 
-    for (const UserFunction& func : gUserFuncs)
+    const CalcSession& session = *ctx.Session;
+    if (const UserFunction* func = lookup_user_func(session, find_name(session.Names, hash, name)))
     {
-        if (func.IsUsed && (strcmp(func.Name, name) == 0))
-        {
-            outVal = eval_user_func(&func, arg1, ctx);
-            return !ctx.Error;
-        }
+        outVal = eval_user_func(func, arg1, ctx);
+        return !ctx.Error;
     }
 
     outVal = 0.0;
@@ -142,36 +184,80 @@ double eval_user_func(const UserFunction* func, double arg1, ParseCtx& ctx)
         return 0.0f;
     }
 
-    define_value(func->Arg, arg1, ctx);
+    if (ctx.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return 0.0;
+    }
+
+    ++ctx.CallDepth;
+    const double val = run_program(func->Code, &arg1, ctx);
+    --ctx.CallDepth;
 
-    ParseCtx innerCtx { .InBuffer = func->Def, .ResBuffer = ctx.ResBuffer, .ResBufferLen = ctx.ResBufferLen };
-    advance_token(innerCtx);
-    double val = parse_expression(innerCtx);
+    return val;
+}
 
-    if (innerCtx.Error)
-        ctx.Error = true;
+bool eval_user_func_batch(const UserFunction* func, const double* xs, double* ys, int n, ParseCtx& ctx)
+{
+    if (!func)
+    {
+        on_parse_error(ctx, "missing function");
+        return false;
+    }
 
-    undef_value(func->Arg);
+    if (ctx.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return false;
+    }
+
+    ++ctx.CallDepth;
+    const bool ok = run_program_batch(func->Code, xs, ys, n, ctx);
+    --ctx.CallDepth;
+
+    return ok;
+}
+
+Interval eval_user_func_interval(const UserFunction* func, Interval arg1, ParseCtx& ctx)
+{
+    if (!func)
+    {
+        on_parse_error(ctx, "missing function");
+        return kEntireInterval;
+    }
+
+    if (ctx.CallDepth >= kMaxCallDepth)
+    {
+        on_parse_error(ctx, "too much recursion");
+        return kEntireInterval;
+    }
+
+    ++ctx.CallDepth;
+    const Interval val = run_program_interval(func->Code, &arg1, ctx);
+    --ctx.CallDepth;
 
     return val;
 }
 
 //-----------------------------------------------------------------------------------------------
 
-bool is_user_func(const char* name)
+bool is_user_func(const CalcSession& session, NameId name)
 {
-    return (lookup_user_func(name) != nullptr);
+    return (lookup_user_func(session, name) != nullptr);
 }
 
-const UserFunction* lookup_user_func(const char* name)
+const UserFunction* lookup_user_func(const CalcSession& session, NameId name)
 {
-    for (const UserFunction& func : gUserFuncs)
-    {
-        if (func.IsUsed && (strcmp(func.Name, name) == 0))
-            return &func;
-    }
+    const FunctionTable& funcs = session.Functions;
+    if (name >= kMaxNames || !funcs.ByName[name])
+        return nullptr;
 
-    return nullptr;
+    return &funcs.Funcs[funcs.ByName[name] - 1];
+}
+
+const UserFunction* lookup_user_func(const CalcSession& session, const char* name)
+{
+    return lookup_user_func(session, find_name(session.Names, name));
 }
 
 //-----------------------------------------------------------------------------------------------
@@ -200,21 +286,21 @@ const char* function_name(BuiltinFunctionIt it)
     return it->Name;
 }
 
-UserFunctionIt function_user_begin()
+UserFunctionIt function_user_begin(const CalcSession& session)
 {
-    UserFunctionIt it = gUserFuncs;
+    UserFunctionIt it = session.Functions.Funcs;
     if (!it->IsUsed)
-        it = function_next(it);
+        it = function_next(session, it);
 
     return it;
 }
 
-UserFunctionIt function_next(UserFunctionIt it)
+UserFunctionIt function_next(const CalcSession& session, UserFunctionIt it)
 {
     if (!it)
         return nullptr;
 
-    for (++it; it <= gUserFuncs + kMaxUserFuncs; ++it)
+    for (++it; it < session.Functions.Funcs + kMaxUserFuncs; ++it)
     {
         if (it->IsUsed)
             return it;
@@ -223,12 +309,12 @@ UserFunctionIt function_next(UserFunctionIt it)
     return nullptr;
 }
 
-const char* function_name(UserFunctionIt it)
+const char* function_name(const CalcSession& session, UserFunctionIt it)
 {
     if (!it || !it->IsUsed)
         return "<undefined>";
 
-    return it->Name;
+    return name_str(session.Names, it->Name);
 }
 
 const char* function_def(UserFunctionIt it)
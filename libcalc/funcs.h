@@ -1,38 +1,83 @@
 #pragma once
 
+#include "bytecode.h"
+#include "names.h"
+
 //-------------------------------------------------------------------------------------------------
 
+struct CalcSession;
 struct ParseCtx;
-struct UserFunction;
+
+//-------------------------------------------------------------------------------------------------
+
+constexpr int kMaxFuncDefLen = 255;
+constexpr int kMaxUserFuncs = 10;
+
+struct UserFunction
+{
+    NameId Name = kInvalidName;
+    NameId Arg = kInvalidName;
+
+    char Def[kMaxFuncDefLen+1] = {0};
+    Program Code;
+
+    bool IsUsed = false;
+};
+
+struct FunctionTable
+{
+    UserFunction Funcs[kMaxUserFuncs];
+
+    // 1 + the index into Funcs for each interned name, or 0 if it's not a user function
+    uint8_t ByName[kMaxNames] = {0};
+
+    // definitions are compiled here first so a bad one doesn't clobber an existing function
+    Program CompileScratch;
+};
+static_assert(kMaxUserFuncs < 255);
+static_assert(kMaxCallDepth >= kMaxUserFuncs, "a chain through every user function has to fit");
 
 //-------------------------------------------------------------------------------------------------
 
 bool eval_function(const char* name, double arg1, double& outVal, ParseCtx& ctx);
 
+// returns the index of the named builtin function, or -1 if there isn't one
+int find_builtin_function(uint32_t hash, const char* name);
+int find_builtin_function(const char* name);
+double call_builtin_function(int ix, double arg1);
+Interval call_builtin_function_interval(int ix, Interval arg1);
+
 double eval_user_func(const UserFunction* func, double arg1, ParseCtx& ctx);
 
+// evaluates ys[i] = func(xs[i]) for i in [0,n); much quicker than calling eval_user_func n times
+// ys can be the same array as xs
+bool eval_user_func_batch(const UserFunction* func, const double* xs, double* ys, int n, ParseCtx& ctx);
+
+// bounds func over every arg in arg1
+Interval eval_user_func_interval(const UserFunction* func, Interval arg1, ParseCtx& ctx);
+
 //-------------------------------------------------------------------------------------------------
 
 bool define_function(const char* name, const char* arg, ParseCtx& ctx);
 
-bool is_user_func(const char* name);
-const UserFunction* lookup_user_func(const char* name);
+bool is_user_func(const CalcSession& session, NameId name);
+const UserFunction* lookup_user_func(const CalcSession& session, NameId name);
+const UserFunction* lookup_user_func(const CalcSession& session, const char* name);
 
 //-------------------------------------------------------------------------------------------------
 
 struct FunctionDef;
 using BuiltinFunctionIt = const FunctionDef*;
 
-struct UserFunction;
 using UserFunctionIt = const UserFunction*;
 
 BuiltinFunctionIt function_builtin_begin();
 BuiltinFunctionIt function_next(BuiltinFunctionIt it);
 const char* function_name(BuiltinFunctionIt it);
 
-UserFunctionIt function_user_begin();
-UserFunctionIt function_next(UserFunctionIt it);
-const char* function_name(UserFunctionIt it);
+UserFunctionIt function_user_begin(const CalcSession& session);
+UserFunctionIt function_next(const CalcSession& session, UserFunctionIt it);
+const char* function_name(const CalcSession& session, UserFunctionIt it);
 const char* function_def(UserFunctionIt it);
 
 //-------------------------------------------------------------------------------------------------
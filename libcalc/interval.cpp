@@ -0,0 +1,258 @@
+#include "interval.h"
+
+#include "maths.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//-------------------------------------------------------------------------------------------------
+
+// 0 * inf counts as 0 here: the inf end of an interval is a limit that's never actually reached
+static inline double mul_ends(double a, double b)
+{
+    const double p = a * b;
+    return (p == p) ? p : 0.0;
+}
+
+// true if some offset + k*period (for integer k) is inside a
+static bool contains_periodic(const Interval& a, double offset, double period)
+{
+    const double k = ceil((a.Lo - offset) / period);
+    return (offset + (k * period)) <= a.Hi;
+}
+
+static Interval ordered(double a, double b)
+{
+    return (a < b) ? make_interval(a, b) : make_interval(b, a);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Interval interval_negate(Interval a)
+{
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+
+    return make_interval(-a.Hi, -a.Lo);
+}
+
+Interval interval_add(Interval a, Interval b)
+{
+    if (interval_is_empty(a) || interval_is_empty(b))
+        return kEmptyInterval;
+
+    return make_interval(a.Lo + b.Lo, a.Hi + b.Hi);
+}
+
+Interval interval_subtract(Interval a, Interval b)
+{
+    if (interval_is_empty(a) || interval_is_empty(b))
+        return kEmptyInterval;
+
+    return make_interval(a.Lo - b.Hi, a.Hi - b.Lo);
+}
+
+Interval interval_multiply(Interval a, Interval b)
+{
+    if (interval_is_empty(a) || interval_is_empty(b))
+        return kEmptyInterval;
+
+    const double p0 = mul_ends(a.Lo, b.Lo);
+    const double p1 = mul_ends(a.Lo, b.Hi);
+    const double p2 = mul_ends(a.Hi, b.Lo);
+    const double p3 = mul_ends(a.Hi, b.Hi);
+
+    return make_interval(std::min(std::min(p0, p1), std::min(p2, p3)),
+                         std::max(std::max(p0, p1), std::max(p2, p3)));
+}
+
+Interval interval_divide(Interval a, Interval b)
+{
+    if (interval_is_empty(a) || interval_is_empty(b))
+        return kEmptyInterval;
+
+    Interval recip;
+    if (b.Lo > 0 || b.Hi < 0)
+        recip = make_interval(1.0 / b.Hi, 1.0 / b.Lo);
+    else if (b.Lo == 0 && b.Hi > 0)
+        recip = make_interval(1.0 / b.Hi, kIntervalInf);
+    else if (b.Hi == 0 && b.Lo < 0)
+        recip = make_interval(-kIntervalInf, 1.0 / b.Lo);
+    else
+        return kEntireInterval;     // dividing by something that straddles 0: a pole
+
+    return interval_multiply(a, recip);
+}
+
+static Interval interval_int_power(Interval a, int n)
+{
+    if (n == 0)
+        return make_interval(1, 1);
+    if (n < 0)
+        return interval_divide(make_interval(1, 1), interval_int_power(a, -n));
+
+    const double lo = pow(a.Lo, n);
+    const double hi = pow(a.Hi, n);
+    if ((n & 1) || a.Lo >= 0)
+        return make_interval(lo, hi);
+    if (a.Hi <= 0)
+        return make_interval(hi, lo);
+
+    return make_interval(0, std::max(lo, hi));
+}
+
+Interval interval_power(Interval a, Interval b)
+{
+    if (interval_is_empty(a) || interval_is_empty(b))
+        return kEmptyInterval;
+
+    // constant integer powers (x^2 etc) are the common case, and are fine with negative bases
+    if (b.Lo == b.Hi && b.Lo == floor(b.Lo) && fabs(b.Lo) < 1024)
+        return interval_int_power(a, int(b.Lo));
+
+    // otherwise pow is only defined for non-negative bases, where a^b = e^(b ln a)
+    // nb. this ignores negative bases raised to the odd integer that might be inside b
+    const Interval e = interval_multiply(b, interval_ln(a));
+    if (interval_is_empty(e))
+        return kEmptyInterval;
+
+    return make_interval(exp(e.Lo), exp(e.Hi));
+}
+
+Interval interval_factorial(Interval a)
+{
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+
+    // only the integers inside a have factorials, and they only get bigger
+    const double lo = std::max(0.0, ceil(a.Lo - FLT_EPSILON));
+    const double hi = floor(a.Hi + FLT_EPSILON);
+    if (lo > hi)
+        return kEmptyInterval;
+
+    constexpr double kMaxFiniteFactorial = 170;
+
+    double loFact = lo;
+    double hiFact = hi;
+    if (lo > kMaxFiniteFactorial)
+        loFact = kIntervalInf;
+    else
+        compute_factorial(loFact);
+    if (hi > kMaxFiniteFactorial)
+        hiFact = kIntervalInf;
+    else
+        compute_factorial(hiFact);
+
+    return make_interval(loFact, hiFact);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Interval interval_sin(Interval a)
+{
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+    if (!(a.Hi - a.Lo < 2 * pi))
+        return make_interval(-1, 1);
+
+    const Interval ends = ordered(sin(a.Lo), sin(a.Hi));
+    return make_interval(contains_periodic(a, -pi / 2, 2 * pi) ? -1 : ends.Lo,
+                         contains_periodic(a, pi / 2, 2 * pi) ? 1 : ends.Hi);
+}
+
+Interval interval_cos(Interval a)
+{
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+    if (!(a.Hi - a.Lo < 2 * pi))
+        return make_interval(-1, 1);
+
+    const Interval ends = ordered(cos(a.Lo), cos(a.Hi));
+    return make_interval(contains_periodic(a, pi, 2 * pi) ? -1 : ends.Lo,
+                         contains_periodic(a, 0, 2 * pi) ? 1 : ends.Hi);
+}
+
+Interval interval_tan(Interval a)
+{
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+    if (!(a.Hi - a.Lo < pi) || contains_periodic(a, pi / 2, pi))
+        return kEntireInterval;
+
+    return make_interval(tan(a.Lo), tan(a.Hi));
+}
+
+Interval interval_sinc(Interval a)
+{
+    // sinc never goes below its first minimum, at x = +-4.4934
+    constexpr double kSincMin = -0.21723362821122166;
+
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+
+    // the main lobe falls away on both sides of 0
+    if (a.Lo >= -pi && a.Hi <= pi)
+    {
+        if (a.Lo <= 0 && a.Hi >= 0)
+            return make_interval(sinc(std::max(-a.Lo, a.Hi)), 1);
+
+        return ordered(sinc(a.Lo), sinc(a.Hi));
+    }
+
+    if (a.Lo <= 0 && a.Hi >= 0)
+        return make_interval(kSincMin, 1);
+
+    const Interval q = interval_divide(interval_sin(a), a);
+    return make_interval(std::max(q.Lo, kSincMin), std::min(q.Hi, 1.0));
+}
+
+Interval interval_asin(Interval a)
+{
+    if (interval_is_empty(a) || a.Lo > 1 || a.Hi < -1)
+        return kEmptyInterval;
+
+    return make_interval(asin(std::max(a.Lo, -1.0)), asin(std::min(a.Hi, 1.0)));
+}
+
+Interval interval_acos(Interval a)
+{
+    if (interval_is_empty(a) || a.Lo > 1 || a.Hi < -1)
+        return kEmptyInterval;
+
+    return make_interval(acos(std::min(a.Hi, 1.0)), acos(std::max(a.Lo, -1.0)));
+}
+
+Interval interval_atan(Interval a)
+{
+    if (interval_is_empty(a))
+        return kEmptyInterval;
+
+    return make_interval(atan(a.Lo), atan(a.Hi));
+}
+
+Interval interval_ln(Interval a)
+{
+    if (interval_is_empty(a) || a.Hi < 0)
+        return kEmptyInterval;
+
+    return make_interval((a.Lo > 0) ? log(a.Lo) : -kIntervalInf, log(a.Hi));
+}
+
+Interval interval_log10(Interval a)
+{
+    if (interval_is_empty(a) || a.Hi < 0)
+        return kEmptyInterval;
+
+    return make_interval((a.Lo > 0) ? log10(a.Lo) : -kIntervalInf, log10(a.Hi));
+}
+
+Interval interval_sqrt(Interval a)
+{
+    if (interval_is_empty(a) || a.Hi < 0)
+        return kEmptyInterval;
+
+    return make_interval(sqrt(std::max(a.Lo, 0.0)), sqrt(a.Hi));
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <limits>
+
+//-------------------------------------------------------------------------------------------------
+
+// a range of values [Lo, Hi] that an expression is guaranteed to stay within over a range of
+// inputs. either end can be infinite, which is how poles show up
+// nb. there's no outward rounding, so the bounds can be out by an ulp or so; that's plenty for
+// deciding what to draw
+struct Interval
+{
+    double Lo;
+    double Hi;
+};
+
+constexpr double kIntervalInf = std::numeric_limits<double>::infinity();
+
+// the empty interval (eg. sqrt of [-2,-1]) has Lo > Hi
+constexpr Interval kEmptyInterval = { kIntervalInf, -kIntervalInf };
+constexpr Interval kEntireInterval = { -kIntervalInf, kIntervalInf };
+
+// nan ends (from inf-inf etc) are widened out to infinity so the result stays safe
+inline Interval make_interval(double lo, double hi)
+{
+    return { (lo == lo) ? lo : -kIntervalInf, (hi == hi) ? hi : kIntervalInf };
+}
+
+inline bool interval_is_empty(const Interval& a)
+{
+    return !(a.Lo <= a.Hi);
+}
+
+inline bool interval_is_bounded(const Interval& a)
+{
+    return (a.Lo > -kIntervalInf && a.Hi < kIntervalInf);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+Interval interval_negate(Interval a);
+Interval interval_add(Interval a, Interval b);
+Interval interval_subtract(Interval a, Interval b);
+Interval interval_multiply(Interval a, Interval b);
+Interval interval_divide(Interval a, Interval b);
+Interval interval_power(Interval a, Interval b);
+Interval interval_factorial(Interval a);
+
+// interval versions of the builtin functions
+Interval interval_sin(Interval a);
+Interval interval_cos(Interval a);
+Interval interval_tan(Interval a);
+Interval interval_sinc(Interval a);
+Interval interval_asin(Interval a);
+Interval interval_acos(Interval a);
+Interval interval_atan(Interval a);
+Interval interval_ln(Interval a);
+Interval interval_log10(Interval a);
+Interval interval_sqrt(Interval a);
+
+//-------------------------------------------------------------------------------------------------
@@ -7,6 +7,7 @@
 #include "funcs.h"
 #include "parser.h"
 #include "plot.h"
+#include "session.h"
 #include "symbols.h"
 
 #include <cmath>
@@ -15,16 +16,26 @@
 
 //-------------------------------------------------------------------------------------------------
 
-calc_puts_func calc_puts_fn;
+static CalcSession gDefaultSession;
 
-void calc_puts(const char* str)
+CalcSession* calc_default_session()
+{
+    return &gDefaultSession;
+}
+
+void calc_puts(const CalcSession& session, const char* str)
 {
-    if (calc_puts_fn)
+    if (session.Puts)
     {
-        calc_puts_fn(str);
+        session.Puts(str);
     }
 }
 
+void calc_puts(const char* str)
+{
+    calc_puts(gDefaultSession, str);
+}
+
 //-------------------------------------------------------------------------------------------------
 
 // assignment ::= "->" | "="
@@ -62,12 +73,17 @@ bool parse_definition(ParseCtx& ctx)
     {
         // the remainder of the expression becomes the registered implementation of function <name>
         ParseCtx innerCtx {
+            .Session = ctx.Session,
             .InBuffer = postAssignBuf,
             .ResBuffer = ctx.ResBuffer,
             .ResBufferLen = ctx.ResBufferLen
         };
         if (!define_function(name, arg, innerCtx))
+        {
+            // the error has already been reported through innerCtx
+            ctx.Error = true;
             return false;
+        }
 
         // we've eaten all the rest of the input
         ctx.NextToken = Token::Eof;
@@ -120,7 +136,7 @@ bool cmd_graph_y(ParseCtx& ctx)
         on_parse_error(ctx, "need user func name for y=f(x)");
         return false;
     }
-    if (!is_user_func(func_name))
+    if (!lookup_user_func(*ctx.Session, func_name))
     {
         on_parse_error(ctx, "unknown user function");
         return false;
@@ -165,7 +181,7 @@ bool try_parse_command(ParseCtx& ctx)
     if (!peek(ctx, Token::Symbol))
         return false;
 
-    const CommandDef* cmd = lookup_command(ctx.TokenSymbol);
+    const CommandDef* cmd = lookup_command(*ctx.Session, ctx.TokenName);
     if (!cmd)
         return false;
 
@@ -183,26 +199,44 @@ bool try_parse_command(ParseCtx& ctx)
 
 //-------------------------------------------------------------------------------------------------
 
-void calc_init(calc_puts_func puts_func)
+void calc_session_init(CalcSession& session, calc_puts_func puts_func)
 {
-    calc_puts_fn = puts_func;
+    session.Puts = puts_func;
 
-    init_commands();
+    init_commands(session);
 
-    register_calc_cmd(cmd_graph_y, "g", "g fn [lo<x<hi] [, lo<y<hi]", "graph of y=fn(x)");
+    register_calc_cmd(session, cmd_graph_y, "g", "g fn [lo<x<hi] [, lo<y<hi]", "graph of y=fn(x)");
 
-    register_chaos_commands();
+    register_chaos_commands(session);
+}
+
+void calc_init(calc_puts_func puts_func)
+{
+    calc_session_init(gDefaultSession, puts_func);
+}
+
+CalcSession* calc_session_create(calc_puts_func puts_func)
+{
+    CalcSession* session = new CalcSession;
+    calc_session_init(*session, puts_func);
+    return session;
+}
+
+void calc_session_destroy(CalcSession* session)
+{
+    if (session != &gDefaultSession)
+        delete session;
 }
 
 //-------------------------------------------------------------------------------------------------
 
-bool calc_eval(const char* expr, char* resBuffer, int resBufferLen)
+bool calc_session_eval(CalcSession* session, const char* expr, char* resBuffer, int resBufferLen)
 {
-    if (!resBuffer)
+    if (!session || !resBuffer)
         return false;
     *resBuffer = 0;
 
-    ParseCtx parseCtx { .InBuffer=expr, .ResBuffer=resBuffer, .ResBufferLen=resBufferLen };
+    ParseCtx parseCtx { .Session=session, .InBuffer=expr, .ResBuffer=resBuffer, .ResBufferLen=resBufferLen };
     advance_token(parseCtx);
 
     // scan the expression to see if it's something unusual
@@ -238,5 +272,7 @@ bool calc_eval(const char* expr, char* resBuffer, int resBufferLen)
     return !parseCtx.Error;
 }
 
-
-
+bool calc_eval(const char* expr, char* resBuffer, int resBufferLen)
+{
+    return calc_session_eval(&gDefaultSession, expr, resBuffer, resBufferLen);
+}
@@ -12,6 +12,15 @@ extern "C" {
 
 //-------------------------------------------------------------------------------------------------
 
+// a session holds all of a calculator's state (symbols, functions, commands, output, plot)
+// separate sessions share nothing, so they can be evaluated at the same time
+// the plain calc_* functions below all work on the default session
+typedef struct CalcSession CalcSession;
+
+CalcSession* calc_default_session();
+
+//-------------------------------------------------------------------------------------------------
+
 // used to specify a printing function that the calc can use
 typedef void (*calc_puts_func)(const char* str);
 
@@ -29,6 +38,13 @@ void register_calc_cmd(calc_cmd_func func, const char* name, const char* usage,
 void calc_init(calc_puts_func puts_func);
 bool calc_eval(const char* expr, char* resBuffer, int resBufferLen);
 
+// new sessions come with the builtin commands registered, like calc_init
+CalcSession* calc_session_create(calc_puts_func puts_func);
+void calc_session_destroy(CalcSession* session);
+
+void calc_session_register_cmd(CalcSession* session, calc_cmd_func func, const char* name, const char* usage, const char* help);
+bool calc_session_eval(CalcSession* session, const char* expr, char* resBuffer, int resBufferLen);
+
 //-------------------------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------------------------
 
@@ -40,15 +56,20 @@ bool calc_eval(const char* expr, char* resBuffer, int resBufferLen);
 #define MC_PLOT_HEIGHT  (((MC_PLOT_WIDTH) * 3) / 4)
 #endif
 
-typedef struct
-{
-    uint16_t Pixels[MC_PLOT_WIDTH * MC_PLOT_HEIGHT];
-} Plot;
-
+// a finished plot. it doesn't hold an image: rows are rasterised on demand from the plotted
+// curve, so only a few rows' worth of pixels ever exist at once
+typedef struct Plot Plot;
 
 const Plot* get_plot(); // returns null if a plot hasn't been created since reset_plot()
 void reset_plot();
 
+// renders row y of plot into MC_PLOT_WIDTH RGB565 pixels. rows are cheapest fetched in order,
+// top to bottom
+void get_plot_row(const Plot* plot, int y, uint16_t* rowBuf);
+
+const Plot* calc_session_get_plot(const CalcSession* session);
+void calc_session_reset_plot(CalcSession* session);
+
 //-------------------------------------------------------------------------------------------------
 
 #ifdef __cplusplus
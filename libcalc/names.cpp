@@ -0,0 +1,78 @@
+#include "names.h"
+
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+// keep some slack so probe sequences stay short
+constexpr int kMaxInternedNames = (kMaxNames * 3) / 4;
+
+//-------------------------------------------------------------------------------------------------
+
+static inline bool is_free(const NameEntry& entry)
+{
+    return entry.Name[0] == 0;
+}
+
+NameId find_name(const NameTable& names, uint32_t hash, const char* name)
+{
+    for (uint32_t slot = hash & (kMaxNames - 1); !is_free(names.Entries[slot]); slot = (slot + 1) & (kMaxNames - 1))
+    {
+        const NameEntry& entry = names.Entries[slot];
+        if (entry.Hash == hash && strcmp(entry.Name, name) == 0)
+            return NameId(slot);
+    }
+
+    return kInvalidName;
+}
+
+NameId find_name(const NameTable& names, const char* name)
+{
+    return find_name(names, hash_name(name), name);
+}
+
+NameId intern_name(NameTable& names, uint32_t hash, const char* name)
+{
+    if (!name || !*name || strlen(name) > kMaxSymbolLength)
+        return kInvalidName;
+
+    uint32_t slot = hash & (kMaxNames - 1);
+    for (; !is_free(names.Entries[slot]); slot = (slot + 1) & (kMaxNames - 1))
+    {
+        const NameEntry& entry = names.Entries[slot];
+        if (entry.Hash == hash && strcmp(entry.Name, name) == 0)
+            return NameId(slot);
+    }
+
+    if (names.Count >= kMaxInternedNames)
+        return kInvalidName;
+
+    NameEntry& entry = names.Entries[slot];
+    entry.Hash = hash;
+    strcpy(entry.Name, name);
+    names.Order[names.Count++] = NameId(slot);
+
+    return NameId(slot);
+}
+
+NameId intern_name(NameTable& names, const char* name)
+{
+    return intern_name(names, hash_name(name), name);
+}
+
+const char* name_str(const NameTable& names, NameId id)
+{
+    if (id >= kMaxNames || is_free(names.Entries[id]))
+        return "<invalid>";
+
+    return names.Entries[id].Name;
+}
+
+void forget_names_since(NameTable& names, int mark)
+{
+    // newest first, so every probe sequence goes back to how it was when each name went in
+    while (names.Count > mark)
+        names.Entries[names.Order[--names.Count]] = NameEntry();
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//-------------------------------------------------------------------------------------------------
+
+constexpr int kMaxSymbolLength = 23;
+
+//-------------------------------------------------------------------------------------------------
+
+// every user-defined name (variables, functions, commands) is interned into one open-addressed
+// table, so the tokeniser can turn a symbol into a small id and everything after that just
+// compares ids rather than strings
+
+using NameId = uint8_t;
+
+constexpr int kMaxNames = 128;     // must be a power of two
+constexpr NameId kInvalidName = 0xff;
+
+static_assert((kMaxNames & (kMaxNames - 1)) == 0);
+static_assert(kMaxNames <= kInvalidName);
+
+//-------------------------------------------------------------------------------------------------
+
+// FNV-1a
+constexpr uint32_t kNameHashSeed = 2166136261u;
+
+constexpr uint32_t hash_name_step(uint32_t hash, char c)
+{
+    return (hash ^ uint8_t(c)) * 16777619u;
+}
+
+constexpr uint32_t hash_name(const char* name)
+{
+    uint32_t hash = kNameHashSeed;
+    for (; *name; ++name)
+        hash = hash_name_step(hash, *name);
+    return hash;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+struct NameEntry
+{
+    uint32_t Hash = 0;
+    char Name[kMaxSymbolLength+1] = {0};    // empty if the slot is free
+};
+
+struct NameTable
+{
+    NameEntry Entries[kMaxNames];
+    int Count = 0;
+
+    // the slots in the order they were filled, so the newest names can be forgotten again
+    NameId Order[kMaxNames];
+};
+
+// returns kInvalidName if the name has never been interned
+NameId find_name(const NameTable& names, uint32_t hash, const char* name);
+NameId find_name(const NameTable& names, const char* name);
+
+// returns kInvalidName if the table is full
+NameId intern_name(NameTable& names, uint32_t hash, const char* name);
+NameId intern_name(NameTable& names, const char* name);
+
+const char* name_str(const NameTable& names, NameId id);
+
+// forgets every name interned since names.Count was mark, leaving the table exactly as it was
+// then. for undoing a definition that fails, so a typo doesn't use up names for good
+void forget_names_since(NameTable& names, int mark);
+
+//-------------------------------------------------------------------------------------------------
+
+// a fixed open-addressed index over a table of builtins (anything with a .Name), built at
+// compile time so the builtins don't need interning at startup
+template<int kSlots>
+struct NameHashIndex
+{
+    int8_t Slots[kSlots];   // index into the table, or -1
+};
+
+template<int kSlots, typename T, size_t N>
+constexpr NameHashIndex<kSlots> build_name_index(const T (&table)[N])
+{
+    static_assert((kSlots & (kSlots - 1)) == 0, "slot count must be a power of two");
+    static_assert(kSlots > int(N), "need more slots than names");
+
+    NameHashIndex<kSlots> index {};
+    for (int slot = 0; slot < kSlots; ++slot)
+        index.Slots[slot] = -1;
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        uint32_t slot = hash_name(table[i].Name) & (kSlots - 1);
+        while (index.Slots[slot] >= 0)
+            slot = (slot + 1) & (kSlots - 1);
+
+        index.Slots[slot] = int8_t(i);
+    }
+
+    return index;
+}
+
+// returns the index of name in table, or -1
+// nb. there's always at least one empty slot, so the probe always terminates
+template<int kSlots, typename T, size_t N>
+int find_in_name_index(const NameHashIndex<kSlots>& index, const T (&table)[N], uint32_t hash, const char* name)
+{
+    for (uint32_t slot = hash & (kSlots - 1); index.Slots[slot] >= 0; slot = (slot + 1) & (kSlots - 1))
+    {
+        const int ix = index.Slots[slot];
+        if (strcmp(table[ix].Name, name) == 0)
+            return ix;
+    }
+
+    return -1;
+}
+
+//-------------------------------------------------------------------------------------------------
@@ -1,5 +1,7 @@
 #include "parser.h"
 
+#include "session.h"
+
 #include <algorithm>
 #include <cerrno>
 #include <cstdlib>
@@ -163,9 +165,15 @@ void parse_symbol(ParseCtx& ctx)
     char* out = ctx.TokenSymbol;
     const char* outEnd = ctx.TokenSymbol + kMaxSymbolLength - 1;
 
+    // hash as we go so the name lookup below doesn't need another pass
+    uint32_t hash = hash_name_step(kNameHashSeed, *in);
     *(out++) = *(in++);
     while (out < outEnd && is_symbol_char(*in, false))
-        *(out++) = to_lower_sym(*(in++));
+    {
+        const char c = to_lower_sym(*(in++));
+        hash = hash_name_step(hash, c);
+        *(out++) = c;
+    }
 
     *out = 0;
     
@@ -177,6 +185,8 @@ void parse_symbol(ParseCtx& ctx)
 
     ctx.CurrIx = (in - ctx.InBuffer);
     ctx.NextToken = Token::Symbol;
+    ctx.TokenHash = hash;
+    ctx.TokenName = find_name(ctx.Session->Names, hash, ctx.TokenSymbol);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "libcalc.h"
+#include "names.h"
 
 //-----------------------------------------------------------------------------------------------
 
-constexpr int kMaxSymbolLength = 23;
+struct EvalStack;
 
 //-----------------------------------------------------------------------------------------------
 
@@ -33,6 +35,9 @@ enum class Token
 
 struct ParseCtx
 {
+    // the session whose names, symbols and functions we're parsing/evaluating against
+    CalcSession* Session = calc_default_session();
+
     const char* InBuffer = nullptr;
     int CurrIx = 0;
 
@@ -44,6 +49,14 @@ struct ParseCtx
 
     double TokenNumber = 0.f;
     char TokenSymbol[kMaxSymbolLength+1] = {0};
+    uint32_t TokenHash = 0;
+    NameId TokenName = kInvalidName;    // kInvalidName if the symbol has never been defined
+
+    // how deep in user function calls we are; guards against f(x) = f(x) eating the whole stack
+    int CallDepth = 0;
+
+    // where the programs keep their stacks; the session's first one if not set
+    EvalStack* Stack = nullptr;
 };
 
 //-----------------------------------------------------------------------------------------------
@@ -10,6 +10,10 @@
 
 #define MLN_TARGET_PICO 1
 
+#elif defined(MLN_HEADLESS)    // host build with no display (cli, benchmarks)
+
+#define MLN_TARGET_HEADLESS 1
+
 #else   // other platforms may be available...
 
 #define MLN_TARGET_PC 1
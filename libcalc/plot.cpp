@@ -1,152 +1,496 @@
 #include "plot.h"
 
 #include "funcs.h"
+#include "session.h"
+#include "worker.h"
+
+#include <cstring>
 
 //-------------------------------------------------------------------------------------------------
 
-static Plot gPlot;
-static Plot* gActivePlot = nullptr;
+const Plot* calc_session_get_plot(const CalcSession* session)
+{
+    if (!session || !session->Plot.IsActive)
+        return nullptr;
 
-//-------------------------------------------------------------------------------------------------
+    return &session->Plot.Image;
+}
+
+void calc_session_reset_plot(CalcSession* session)
+{
+    if (session)
+        session->Plot.IsActive = false;
+}
 
 const Plot* get_plot()
 {
-    return gActivePlot;
+    return calc_session_get_plot(calc_default_session());
 }
 
 void reset_plot()
 {
-    gActivePlot = nullptr;
+    calc_session_reset_plot(calc_default_session());
 }
 
 //-------------------------------------------------------------------------------------------------
 
-static inline void safePlot(int x, int y, uint16_t col)
+// palette indices
+constexpr uint8_t kPlotBgCol = 0;
+constexpr uint8_t kPlotAxisCol = 1;
+constexpr uint8_t kPlotLineCol = 2;
+
+// a byte's worth of one colour index
+static constexpr uint8_t fill_byte(uint8_t col)
+{
+    uint8_t byte = 0;
+    for (int i = 0; i < kPlotPixelsPerByte; ++i)
+        byte = uint8_t((byte << kPlotBitsPerPixel) | col);
+    return byte;
+}
+
+static inline void set_pixel(uint8_t* row, int x, uint8_t col)
+{
+    constexpr uint8_t kMask = (1 << kPlotBitsPerPixel) - 1;
+    const int shift = ((kPlotPixelsPerByte - 1) - (x % kPlotPixelsPerByte)) * kPlotBitsPerPixel;
+
+    uint8_t& byte = row[x / kPlotPixelsPerByte];
+    byte = uint8_t((byte & ~(kMask << shift)) | (col << shift));
+}
+
+// the rows of the plot currently being rasterised
+struct PlotBand
+{
+    uint8_t* Pixels;
+    int Top;
+    int Bottom;     // inclusive
+};
+
+// draws column x from y0 to y1 inclusive (in either order), clipped to the band
+static void plot_span(const PlotBand& band, int x, real_t y0, real_t y1, uint8_t col)
 {
-    if (y >= 0 && y < MC_PLOT_HEIGHT)
+    if (x < 0 || x >= MC_PLOT_WIDTH)
+        return;
+
+    const real_t lo = (y0 < y1) ? y0 : y1;
+    const real_t hi = (y0 < y1) ? y1 : y0;
+    if (hi < 0 || lo >= MC_PLOT_HEIGHT)
+        return;
+
+    int loI = (lo < 0) ? 0 : int(lo);
+    int hiI = (hi >= MC_PLOT_HEIGHT) ? (MC_PLOT_HEIGHT - 1) : int(hi);
+    if (loI < band.Top)
+        loI = band.Top;
+    if (hiI > band.Bottom)
+        hiI = band.Bottom;
+
+    uint8_t* row = band.Pixels + ((loI - band.Top) * kPlotRowBytes);
+    for (int y = loI; y <= hiI; ++y, row += kPlotRowBytes)
+        set_pixel(row, x, col);
+}
+
+// draws a line between two points in screen space. each column covers x-0.5 to x+0.5, so a
+// jump between neighbouring columns is split half and half between them
+static void plot_segment(const PlotBand& band, real_t xa, real_t ya, real_t xb, real_t yb, uint8_t col)
+{
+    const int colA = int(xa + real_t(0.5));
+    const int colB = int(xb + real_t(0.5));
+    const real_t slope = (yb - ya) / (xb - xa);
+
+    for (int c = colA; c <= colB; ++c)
+    {
+        const real_t xl = (xa > c - real_t(0.5)) ? xa : (c - real_t(0.5));
+        const real_t xr = (xb < c + real_t(0.5)) ? xb : (c + real_t(0.5));
+        if (xl > xr)
+            continue;
+
+        plot_span(band, c, ya + (xl - xa) * slope, ya + (xr - xa) * slope, col);
+    }
+}
+
+static inline bool is_break(const Plot& plot, int i)
+{
+    return (plot.Breaks[i / 8] >> (i % 8)) & 1;
+}
+
+// rasterises the band of rows starting at top into plot.Band
+static void rasterise_band(const Plot& plot, int top)
+{
+    const int bottom = ((top + kPlotBandRows) < MC_PLOT_HEIGHT) ? (top + kPlotBandRows - 1) : (MC_PLOT_HEIGHT - 1);
+    const PlotBand band { plot.Band, top, bottom };
+
+    memset(plot.Band, fill_byte(kPlotBgCol), sizeof(plot.Band));
+
+    if (plot.AxisRow >= top && plot.AxisRow <= bottom)
+    {
+        uint8_t* row = plot.Band + ((plot.AxisRow - top) * kPlotRowBytes);
+        for (int x = plot.Left; x <= plot.Right; ++x)
+            set_pixel(row, x, kPlotAxisCol);
+    }
+    plot_span(band, plot.AxisCol, real_t(plot.Top), real_t(plot.Bottom), kPlotAxisCol);
+
+    for (int i = 0; i < plot.NumPoints; ++i)
     {
-        gPlot.Pixels[y * MC_PLOT_WIDTH + x] = col;
+        const real_t ya = plot.PointY[i];
+        if (ya != ya)
+            continue;
+
+        const real_t xa = plot.PointX[i];
+        plot_span(band, int(xa + real_t(0.5)), ya, ya, kPlotLineCol);
+
+        if (i + 1 == plot.NumPoints)
+            break;
+
+        // every row a segment touches is between its ends, so most can be skipped outright
+        const real_t yb = plot.PointY[i + 1];
+        if (yb != yb || is_break(plot, i) || (ya < top && yb < top) || (ya >= bottom + 1 && yb >= bottom + 1))
+            continue;
+
+        plot_segment(band, xa, ya, plot.PointX[i + 1], yb, kPlotLineCol);
     }
+
+    plot.BandTop = top;
 }
 
-static void interpolateY(int startXi, int startYi, int endYi, uint16_t col)
+void get_plot_row(const Plot* plot, int y, uint16_t* rowBuf)
 {
-    if (startYi > endYi)
+    constexpr uint8_t kMask = (1 << kPlotBitsPerPixel) - 1;
+
+    const int top = y - (y % kPlotBandRows);
+    if (plot->BandTop != top)
+        rasterise_band(*plot, top);
+
+    const uint8_t* ppix = plot->Band + ((y - top) * kPlotRowBytes);
+    const uint16_t* palette = plot->Palette;
+
+    int x = 0;
+    for (; x + kPlotPixelsPerByte <= MC_PLOT_WIDTH; x += kPlotPixelsPerByte, ++ppix)
     {
-        // asymptote
-        if (startYi - endYi > MC_PLOT_HEIGHT)
-            return;
-
-        if (startYi > MC_PLOT_HEIGHT-1)
-            startYi = MC_PLOT_HEIGHT-1;
-        if (endYi < 0)
-            endYi = 0;
-        if (startYi <= endYi)
-            return;
-
-        const int midYi = (startYi + endYi) / 2;
-        for (int yi = startYi-1; yi > midYi; --yi)
-            safePlot(startXi, yi, col);
-        for (int yi = midYi; yi > endYi; --yi)
-            safePlot(startXi+1, yi, col);
+        uint8_t pix = *ppix;
+        for (int i = kPlotPixelsPerByte - 1; i >= 0; --i, pix >>= kPlotBitsPerPixel)
+            rowBuf[x + i] = palette[pix & kMask];
     }
-    else
+
+    // any pixels left over in a partial last byte
+    if constexpr ((MC_PLOT_WIDTH % kPlotPixelsPerByte) != 0)
     {
-        // asymptote
-        if (startYi - endYi < -MC_PLOT_HEIGHT)
-            return;
-
-        if (startYi < 0)
-            startYi = 0;
-        if (endYi > MC_PLOT_HEIGHT-1)
-            endYi = MC_PLOT_HEIGHT-1;
-        if (startYi >= endYi)
-            return;
-
-        const int midYi = (startYi + endYi) / 2;
-        for (int yi = startYi+1; yi < midYi; ++yi)
-            safePlot(startXi, yi, col);
-        for (int yi = midYi; yi < endYi; ++yi)
-            safePlot(startXi+1, yi, col);
+        for (int shift = 8 - kPlotBitsPerPixel; x < MC_PLOT_WIDTH; ++x, shift -= kPlotBitsPerPixel)
+            rowBuf[x] = palette[(*ppix >> shift) & kMask];
     }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// the other core samples the right-hand half of the plot while this one does the left
+// it gets its own ParseCtx, as that holds the per-evaluation state
+struct PlotSampleJob
+{
+    const UserFunction* Func;
+    const double* Xs;
+    double* Ys;
+    int Count;
+
+    ParseCtx Ctx;
 };
 
-static void plot_hline_fast(int x0, int y, int x1, uint16_t col)
+static void run_plot_sample_job(void* arg)
 {
-    uint16_t* pix = gPlot.Pixels + x0 + (y*MC_PLOT_WIDTH);
-    const uint16_t* pixEnd = pix + (x1 - x0 + 1);
-    while (pix != pixEnd)
-        *(pix++) = col;
+    PlotSampleJob& job = *(PlotSampleJob*)arg;
+    eval_user_func_batch(job.Func, job.Xs, job.Ys, job.Count, job.Ctx);
 }
 
-static void plot_vline_fast(int x, int y0, int y1, uint16_t col)
+// below this, handing half the work to the other core costs more than it saves
+constexpr int kMinParallelSamples = 16;
+
+static void sample_plot(const UserFunction* func, const double* xs, double* ys, int n, ParseCtx& ctx)
 {
-    uint16_t* pix = gPlot.Pixels + x + (y0*MC_PLOT_WIDTH);
-    const uint16_t* pixEnd = pix + (y1 - y0 + 1) * MC_PLOT_WIDTH;
-    for (; pix != pixEnd; pix += MC_PLOT_WIDTH)
-        *pix= col;
+    if (n < kMinParallelSamples)
+    {
+        eval_user_func_batch(func, xs, ys, n, ctx);
+        return;
+    }
+
+    const int half = n / 2;
+
+    char jobResBuf[64] = {0};
+    PlotSampleJob job {
+        .Func = func,
+        .Xs = xs + half,
+        .Ys = ys + half,
+        .Count = n - half,
+        .Ctx = {
+            .Session = ctx.Session,
+            .InBuffer = ctx.InBuffer,
+            .CurrIx = ctx.CurrIx,
+            .ResBuffer = jobResBuf,
+            .ResBufferLen = sizeof(jobResBuf),
+            .CallDepth = ctx.CallDepth,
+            .Stack = &ctx.Session->Stacks[1],
+        },
+    };
+
+    if (!worker_try_start(run_plot_sample_job, &job))
+    {
+        eval_user_func_batch(func, xs, ys, n, ctx);
+        return;
+    }
+
+    eval_user_func_batch(func, xs, ys, half, ctx);
+    worker_wait();
+
+    // report the leftmost error, same as if we'd sampled it all in one go
+    if (job.Ctx.Error && !ctx.Error)
+    {
+        ctx.Error = true;
+        if (ctx.ResBuffer && ctx.ResBufferLen > 0)
+        {
+            strncpy(ctx.ResBuffer, jobResBuf, ctx.ResBufferLen - 1);
+            ctx.ResBuffer[ctx.ResBufferLen - 1] = 0;
+        }
+    }
 }
 
+//-------------------------------------------------------------------------------------------------
+
+// the sampler starts with one sample every few columns and then repeatedly evaluates the
+// midpoints of any intervals that look like they need more detail, down to kPlotSubSamples
+// samples per column. smooth, flat stretches end up needing far fewer evaluations than one
+// per column, and poles/spikes between columns get chased down rather than missed
+constexpr int kCoarseStep = 4;
+constexpr real_t kMinSampleStep = real_t(1) / kPlotSubSamples;
 
-bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, ParseCtx& ctx)
+// before any sampling, spans of this many coarse steps are bounded, and any that are provably
+// off-screen just get sampled at their ends
+constexpr int kCullSpan = 8;
+
+// keeps far off-screen (and infinite) values sane enough to draw lines towards
+static real_t clamp_screen_y(real_t y)
 {
-    if (!func_name || !xAxis || !yAxis)
-        return false;
+    if (y < -MC_PLOT_HEIGHT)
+        return -MC_PLOT_HEIGHT;
+    if (y > 2 * MC_PLOT_HEIGHT)
+        return 2 * MC_PLOT_HEIGHT;
+    return y;
+}
 
-    const UserFunction* func = lookup_user_func(func_name);
-    if (!func)
-        return false;
+static inline real_t sample_midpoint(const PlotState& state, int i)
+{
+    return (state.Image.PointX[i] + state.Image.PointX[i + 1]) * real_t(0.5);
+}
 
-    constexpr int border = 4;
-    const uint16_t bgCol = 0x1862;
-    const uint16_t axisCol = 0x39c4;
-    const uint16_t lineCol = 0xff0a;
+// bounds func between samples i and j. unlike the samples themselves, this can't miss
+// anything between them, so it can tell a pole from a steep slope
+static Interval bound_samples(PlotState& state, const UserFunction* func, const FastAxis& xAx, int i, int j, ParseCtx& ctx)
+{
+    const double xa = xAx.FromScreenF(state.Image.PointX[i]);
+    const double xb = xAx.FromScreenF(state.Image.PointX[j]);
 
-    const FastAxis xAx(*xAxis, border, MC_PLOT_WIDTH - border - 1);
-    const FastAxis yAx(*yAxis, MC_PLOT_HEIGHT - border - 1, border);
+    ++state.Image.NumIntervalEvals;
+    return eval_user_func_interval(func, (xa < xb) ? make_interval(xa, xb) : make_interval(xb, xa), ctx);
+}
+
+static bool is_off_screen(const FastAxis& yAx, const Interval& bounds)
+{
+    if (interval_is_empty(bounds))
+        return true;
+
+    const real_t sa = yAx.ToScreenF(bounds.Lo);
+    const real_t sb = yAx.ToScreenF(bounds.Hi);
+    return (sa < 0 && sb < 0) || (sa >= MC_PLOT_HEIGHT && sb >= MC_PLOT_HEIGHT);
+}
+
+// true if there's nothing to draw at either end of the interval after sample i
+static bool is_hidden_interval(const PlotState& state, int i)
+{
+    const real_t sa = state.Image.PointY[i];
+    const real_t sb = state.Image.PointY[i + 1];
+    return (sa < 0 && sb < 0) || (sa >= MC_PLOT_HEIGHT && sb >= MC_PLOT_HEIGHT);
+}
+
+// true if samples i and i+1 are far enough apart that they might be either side of a pole
+static bool is_big_jump(const PlotState& state, const FastAxis& yAx, int i)
+{
+    const real_t sa = state.Image.PointY[i];
+    const real_t sb = state.Image.PointY[i + 1];
 
-    // clear our plot pixels
-    uint16_t* pix = gPlot.Pixels;
-    uint16_t* pixEnd = pix + (MC_PLOT_WIDTH * MC_PLOT_HEIGHT);
-    for (; pix != pixEnd; ++pix)
-        *pix = bgCol;
+    // screen y goes down as y goes up, so y < 0 is below the x axis's row
+    const real_t axis = yAx.ToScreenF(0);
+    const bool offScreen = (sa < 0 || sa >= MC_PLOT_HEIGHT || sb < 0 || sb >= MC_PLOT_HEIGHT);
+    if (offScreen && ((sa > axis) != (sb > axis)))
+        return true;
+
+    const real_t dy = (sa > sb) ? (sa - sb) : (sb - sa);
+    return (dy > MC_PLOT_HEIGHT / 2);
+}
 
-    // draw some axes
-    const int xZeroScr = int(yAx.ToScreenClamped(0));
-    plot_hline_fast(xAx.LoI, int(xZeroScr), xAx.HiI, axisCol);
+// works out what to do with the interval after sample i; Unchecked means split it
+static SpanState check_span(PlotState& state, const UserFunction* func, const FastAxis& xAx, const FastAxis& yAx, int i, ParseCtx& ctx)
+{
+    const real_t width = state.Image.PointX[i + 1] - state.Image.PointX[i];
+    if (width <= kMinSampleStep)
+        return SpanState::Settled;
+
+    const real_t sa = state.Image.PointY[i];
+    const real_t sb = state.Image.PointY[i + 1];
+    const bool nanA = (sa != sa);
+    const bool nanB = (sb != sb);
+    if (nanA || nanB)
+        return (nanA != nanB) ? SpanState::Unchecked : SpanState::Settled;   // find where the curve starts/stops
+
+    // nothing to see if both ends are off the same edge
+    if (is_hidden_interval(state, i))
+        return SpanState::Settled;
+
+    // above column resolution, refine wherever a straight line could be more than a pixel out
+    if (width > 1)
+        return (((sa > sb) ? (sa - sb) : (sb - sa)) > 1) ? SpanState::Unchecked : SpanState::Settled;
+
+    // below it, only chase down jumps that really are poles; steep slopes just get joined up
+    if (is_big_jump(state, yAx, i))
+        return interval_is_bounded(bound_samples(state, func, xAx, i, i + 1, ctx)) ? SpanState::Continuous : SpanState::Unchecked;
+
+    return SpanState::Settled;
+}
+
+// fills state's samples, counting the evaluations in state.Image
+static void sample_adaptive(PlotState& state, const UserFunction* func, const FastAxis& xAx, const FastAxis& yAx, ParseCtx& ctx)
+{
+    real_t* sampleX = state.Image.PointX;
+    real_t* sampleY = state.Image.PointY;
 
-    const int yZeroScr = int(xAx.ToScreenClamped(0));
-    plot_vline_fast(yZeroScr, yAx.LoI, yAx.HiI, axisCol);
-    
-    double lastY = eval_user_func(func, xAx.LoI, ctx);
-    int lastYi = -1;
+    int numCoarse = 0;
+    for (int xi = xAx.LoI; xi < xAx.HiI; xi += kCoarseStep)
+        sampleX[numCoarse++] = real_t(xi);
+    sampleX[numCoarse++] = real_t(xAx.HiI);
 
-    for (int xi=xAx.LoI; xi<=xAx.HiI; ++xi)
+    // drop the coarse samples inside any span that's off-screen all the way along
+    int n = 0;
+    for (int i = 0; i + 1 < numCoarse; i += kCullSpan)
     {
-        const double x = xAx.FromScreen(xi);
-        const double y = eval_user_func(func, x, ctx);
+        const int end = (i + kCullSpan < numCoarse - 1) ? (i + kCullSpan) : (numCoarse - 1);
+        if (end - i > 1 && is_off_screen(yAx, bound_samples(state, func, xAx, i, end, ctx)))
+        {
+            sampleX[n] = sampleX[i];
+            state.Spans[n++] = SpanState::Settled;
+            continue;
+        }
+
+        for (int k = i; k < end; ++k)
+        {
+            sampleX[n] = sampleX[k];
+            state.Spans[n++] = SpanState::Unchecked;
+        }
+    }
+    sampleX[n++] = sampleX[numCoarse - 1];
+
+    for (int i = 0; i < n; ++i)
+        state.Pending[i] = xAx.FromScreenF(sampleX[i]);
+
+    sample_plot(func, state.Pending, state.Pending, n, ctx);
+    state.Image.NumEvals = n;
 
-        const double yscr = yAx.ToScreen(y);
-        const int yi = int(yscr);
+    for (int i = 0; i < n; ++i)
+        sampleY[i] = yAx.ToScreenF(state.Pending[i]);
 
-        if (y == y)
+    while (!ctx.Error)
+    {
+        int numPending = 0;
+        for (int i = 0; i + 1 < n; ++i)
         {
-            safePlot(xi, yi, lineCol);
+            if (state.Spans[i] == SpanState::Unchecked)
+            {
+                state.Spans[i] = check_span(state, func, xAx, yAx, i, ctx);
+                if (state.Spans[i] == SpanState::Unchecked)
+                    state.Pending[numPending++] = xAx.FromScreenF(sample_midpoint(state, i));
+            }
+        }
+
+        if (ctx.Error || numPending == 0 || n + numPending > kMaxPlotSamples)
+            break;
 
-            // interpolate if needed and if no nans
-            if (xi > xAx.LoI && lastY==lastY)
+        sample_plot(func, state.Pending, state.Pending, numPending, ctx);
+        state.Image.NumEvals += numPending;
+
+        // merge the midpoints in, working backwards so it can be done in place. both halves
+        // of a split interval start off unchecked
+        int out = n + numPending - 1;
+        int pending = numPending - 1;
+        for (int i = n - 1; i >= 0; --i)
+        {
+            if (i + 1 < n && state.Spans[i] == SpanState::Unchecked)
             {
-                const int deltaYi = yi - lastYi;
-                if (deltaYi > 1 || deltaYi < -1)
-                   interpolateY(xi - 1, lastYi, yi, lineCol);
+                sampleX[out] = sample_midpoint(state, i);
+                sampleY[out] = yAx.ToScreenF(state.Pending[pending--]);
+                state.Spans[out] = SpanState::Unchecked;
+                --out;
             }
+
+            sampleX[out] = sampleX[i];
+            sampleY[out] = sampleY[i];
+            state.Spans[out] = state.Spans[i];
+            --out;
         }
 
-        lastY = y;
-        lastYi = yi;
+        n += numPending;
     }
-    
-    gActivePlot = &gPlot;
+
+    state.Image.NumPoints = n;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, ParseCtx& ctx)
+{
+    if (!func_name || !xAxis || !yAxis)
+        return false;
+
+    PlotState& state = ctx.Session->Plot;
+    Plot& plot = state.Image;
+
+    const UserFunction* func = lookup_user_func(*ctx.Session, func_name);
+    if (!func)
+        return false;
+
+    constexpr int border = 4;
+    plot.Palette[kPlotBgCol] = 0x1862;
+    plot.Palette[kPlotAxisCol] = 0x39c4;
+    plot.Palette[kPlotLineCol] = 0xff0a;
+
+    const FastAxis xAx(*xAxis, border, MC_PLOT_WIDTH - border - 1);
+    const FastAxis yAx(*yAxis, MC_PLOT_HEIGHT - border - 1, border);
+
+    // some axes
+    plot.AxisRow = int(yAx.ToScreenClamped(0));
+    plot.AxisCol = int(xAx.ToScreenClamped(0));
+    plot.Left = xAx.LoI;
+    plot.Right = xAx.HiI;
+    plot.Top = yAx.LoI;
+    plot.Bottom = yAx.HiI;
+
+    plot.NumEvals = 0;
+    plot.NumIntervalEvals = 0;
+    sample_adaptive(state, func, xAx, yAx, ctx);
+
+    // work out which samples get joined up in the polyline that's rasterised
+    memset(plot.Breaks, 0, sizeof(plot.Breaks));
+    for (int i = 0; i + 1 < plot.NumPoints; ++i)
+    {
+        if (plot.PointY[i] != plot.PointY[i] || plot.PointY[i + 1] != plot.PointY[i + 1])
+            continue;
+
+        // don't join up anything that's off-screen, or the two sides of a pole
+        bool isBreak = is_hidden_interval(state, i);
+        if (!isBreak && is_big_jump(state, yAx, i) && state.Spans[i] != SpanState::Continuous)
+            isBreak = !interval_is_bounded(bound_samples(state, func, xAx, i, i + 1, ctx));
+
+        if (isBreak)
+            plot.Breaks[i / 8] |= uint8_t(1 << (i % 8));
+    }
+
+    for (int i = 0; i < plot.NumPoints; ++i)
+        plot.PointY[i] = clamp_screen_y(plot.PointY[i]);    // nan stays nan
+    plot.BandTop = -1;
+
+    state.IsActive = true;
 
     return true;
 }
@@ -51,8 +51,16 @@ struct FastAxis
     {
         return Axis.Lo + ((vi - LoI) * UnitsPerPix);
     }
+    real_t FromScreenF(real_t v) const
+    {
+        return Axis.Lo + ((v - LoI) * UnitsPerPix);
+    }
 
     int ToScreen(real_t v) const
+    {
+        return ToScreenF(v);
+    }
+    real_t ToScreenF(real_t v) const
     {
         return (StartI + IRange * ((v - Axis.Lo) * RangeRecip));
     }
@@ -76,6 +84,67 @@ struct FastAxis
 
 //-------------------------------------------------------------------------------------------------
 
+// the sampler goes down to this many samples per column around poles and other sharp features
+constexpr int kPlotSubSamples = 4;
+constexpr int kMaxPlotSamples = MC_PLOT_WIDTH * kPlotSubSamples;
+
+// plots only use a handful of colours, so pixels are 2-bit indices into a palette
+constexpr int kPlotBitsPerPixel = 2;
+constexpr int kPlotPixelsPerByte = 8 / kPlotBitsPerPixel;
+constexpr int kPlotRowBytes = (MC_PLOT_WIDTH + kPlotPixelsPerByte - 1) / kPlotPixelsPerByte;
+constexpr int kPlotPaletteSize = 1 << kPlotBitsPerPixel;
+
+// get_plot_row rasterises this many rows at a time
+constexpr int kPlotBandRows = 8;
+
+struct Plot
+{
+    uint16_t Palette[kPlotPaletteSize];     // RGB565
+    uint32_t NumEvals = 0;          // how many times the function was evaluated to draw this
+    uint32_t NumIntervalEvals = 0;  // ...and how many times it was bounded over a range of x
+
+    // the axes are drawn along row AxisRow from Left to Right, and down column AxisCol from
+    // Top to Bottom
+    int AxisRow = 0, AxisCol = 0;
+    int Left = 0, Right = 0, Top = 0, Bottom = 0;
+
+    // the curve, as a polyline in (fractional) screen coords. y is nan where there's no curve
+    // while it's being drawn, these are the adaptive sampler's samples, sorted by x, with y only
+    // clamped to somewhere near the screen once it's done
+    int NumPoints = 0;
+    real_t PointX[kMaxPlotSamples];
+    real_t PointY[kMaxPlotSamples];
+    uint8_t Breaks[(kMaxPlotSamples + 7) / 8];  // bit i is set if point i isn't joined to i+1
+
+    // the last band of rows get_plot_row rasterised, leftmost pixel in the top bits
+    mutable int BandTop = -1;
+    mutable uint8_t Band[kPlotBandRows * kPlotRowBytes];
+};
+
+enum class SpanState : uint8_t
+{
+    Unchecked,
+    Settled,        // doesn't need splitting any further
+    Continuous,     // ...and has been proved to have no pole in it, so it can be joined up
+};
+
+// everything drawing a plot needs, about 17KB at 240 columns: the Plot itself is about half
+// of it, the rest is the sampler's scratch below
+struct PlotState
+{
+    Plot Image;
+    bool IsActive = false;      // false until something's been drawn since the last reset
+
+    // the adaptive sampler keeps its samples in Image's polyline; this is what's known about
+    // the interval after each one. each refinement pass evaluates the midpoints of the ones
+    // that are still unchecked, with their ys replacing their xs in Pending
+    SpanState Spans[kMaxPlotSamples];
+    double Pending[kMaxPlotSamples];
+};
+
+//-------------------------------------------------------------------------------------------------
+
+// draws into ctx's session's plot
 bool draw_plot(const char* func_name, const PlotAxis* xAxis, const PlotAxis* yAxis, ParseCtx& ctx);
 
 //-------------------------------------------------------------------------------------------------
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "libcalc.h"
+
+#include "bytecode.h"
+#include "cmd.h"
+#include "funcs.h"
+#include "names.h"
+#include "plot.h"
+#include "symbols.h"
+
+//-------------------------------------------------------------------------------------------------
+
+// everything one calculator knows about. nothing in here is shared between sessions, so
+// different sessions can evaluate at the same time; a single session isn't thread safe
+struct CalcSession
+{
+    calc_puts_func Puts = nullptr;
+
+    NameTable Names;
+    SymbolTable Symbols;
+    FunctionTable Functions;
+    CommandTable Commands;
+
+    PlotState Plot;
+
+    // plain expressions are compiled into here and run straight away
+    Program Scratch;
+
+    // programs' stacks: the first for the calling core, the second for the worker
+    EvalStack Stacks[2];
+};
+
+//-------------------------------------------------------------------------------------------------
+
+// print a string through the session's puts fn
+void calc_puts(const CalcSession& session, const char* str);
+
+// registers the builtin commands and sets the output fn
+void calc_session_init(CalcSession& session, calc_puts_func puts_func);
+
+//-------------------------------------------------------------------------------------------------
@@ -1,99 +1,101 @@
 #include "symbols.h"
 
 #include "parser.h"
+#include "session.h"
 
 #include <cstring>
 
 //-----------------------------------------------------------------------------------------------
 
-constexpr int kMaxUserSymbols = 25;
-
-//-----------------------------------------------------------------------------------------------
-
 struct SymbolDef
 {
     const char* Name = nullptr;
     double Value = 0.0;
 };
 
-struct UserSymbol
-{
-    char Name[kMaxSymbolLength+1] = {0};
-    double Value = 0.0;
-
-    bool IsUsed = false;
-};
-
 //-----------------------------------------------------------------------------------------------
 
-SymbolDef gSymbols[] = 
+constexpr SymbolDef gSymbols[] = 
 {
     { .Name = "pi", .Value = 3.1415926535897932384626433 },
     { .Name = "e",  .Value = 2.7182818284590452353602874 },
 };
 constexpr int kNumSymbols = sizeof(gSymbols) / sizeof(gSymbols[0]);
-
-UserSymbol gUserSymbols[kMaxUserSymbols];
+constexpr NameHashIndex<4> kSymbolIndex = build_name_index<4>(gSymbols);
 
 //-----------------------------------------------------------------------------------------------
 
-const SymbolDef* find_core_symbol(const char* name)
+static const SymbolDef* find_core_symbol(uint32_t hash, const char* name)
 {
-    for (const SymbolDef& sym : gSymbols)
-    {
-        if (strcmp(sym.Name, name) == 0)
-        {
-            return &sym;
-        }
-    }
-    return nullptr;
+    const int ix = find_in_name_index(kSymbolIndex, gSymbols, hash, name);
+    if (ix < 0)
+        return nullptr;
+
+    return &gSymbols[ix];
+}
+
+static inline const UserSymbol* find_user_symbol(const SymbolTable& symbols, NameId name)
+{
+    if (name >= kMaxNames || !symbols.ByName[name])
+        return nullptr;
+
+    return &symbols.Symbols[symbols.ByName[name] - 1];
 }
 
-bool eval_named_value(const char* name, double& outVal)
+bool eval_builtin_value(uint32_t hash, const char* name, double& outVal)
 {
-    if (const SymbolDef* sym = find_core_symbol(name))
+    if (const SymbolDef* sym = find_core_symbol(hash, name))
     {
         outVal = sym->Value;
         return true;
     }
 
-    for (const UserSymbol& sym : gUserSymbols)
+    return false;
+}
+
+bool eval_builtin_value(const char* name, double& outVal)
+{
+    return eval_builtin_value(hash_name(name), name, outVal);
+}
+
+bool eval_user_value(const CalcSession& session, NameId name, double& outVal)
+{
+    if (const UserSymbol* sym = find_user_symbol(session.Symbols, name))
     {
-        if (sym.IsUsed && (strcmp(sym.Name, name) == 0))
-        {
-            outVal = sym.Value;
-            return true;
-        }
+        outVal = sym->Value;
+        return true;
     }
 
     outVal = 0.0;
     return false;
 }
 
+bool eval_named_value(const CalcSession& session, const char* name, double& outVal)
+{
+    const uint32_t hash = hash_name(name);
+    if (eval_builtin_value(hash, name, outVal))
+        return true;
+
+    return eval_user_value(session, find_name(session.Names, hash, name), outVal);
+}
+
 //-----------------------------------------------------------------------------------------------
 
-static UserSymbol* find_or_alloc_usersym(const char* name)
+static UserSymbol* find_or_alloc_usersym(SymbolTable& symbols, NameId name)
 {
-    UserSymbol* free_sym = nullptr;
+    if (symbols.ByName[name])
+        return &symbols.Symbols[symbols.ByName[name] - 1];
 
-    for (UserSymbol& sym : gUserSymbols)
+    for (int ix = 0; ix < kMaxUserSymbols; ++ix)
     {
-        if (!sym.IsUsed)
-        {
-            if (!free_sym)
-                free_sym = &sym;
+        UserSymbol& sym = symbols.Symbols[ix];
+        if (sym.IsUsed)
             continue;
-        }
 
-        if (strcmp(name, sym.Name) == 0)
-            return &sym;
-    }
-
-    if (free_sym)
-    {
-        strcpy(free_sym->Name, name);
-        free_sym->IsUsed = true;
-        return free_sym;
+        sym.Name = name;
+        sym.IsUsed = true;
+        symbols.ByName[name] = uint8_t(ix + 1);
+        return &sym;
     }
 
     return nullptr;
@@ -101,15 +103,27 @@ static UserSymbol* find_or_alloc_usersym(const char* name)
 
 bool define_value(const char* name, double val, ParseCtx& ctx)
 {
-    if (find_core_symbol(name))
+    const uint32_t hash = hash_name(name);
+    if (find_core_symbol(hash, name))
     {
         on_parse_error(ctx, "can't redefine a constant");
         return false;
     }
 
-    UserSymbol* sym = find_or_alloc_usersym(name);
+    CalcSession& session = *ctx.Session;
+
+    const int namesMark = session.Names.Count;
+    const NameId nameId = intern_name(session.Names, hash, name);
+    if (nameId == kInvalidName)
+    {
+        on_parse_error(ctx, "too many names");
+        return false;
+    }
+
+    UserSymbol* sym = find_or_alloc_usersym(session.Symbols, nameId);
     if (!sym)
     {
+        forget_names_since(session.Names, namesMark);
         on_parse_error(ctx, "too many user symbols");
         return false;
     }
@@ -118,15 +132,6 @@ bool define_value(const char* name, double val, ParseCtx& ctx)
     return true;
 }
 
-void undef_value(const char* name)
-{
-    UserSymbol* sym = find_or_alloc_usersym(name);
-    if (sym)
-    {
-        sym->IsUsed = false;
-    }
-}
-
 //-----------------------------------------------------------------------------------------------
 
 BuiltinSymbolIt symbol_builtin_begin()
@@ -154,22 +159,22 @@ const char* symbol_name(BuiltinSymbolIt it)
     return it->Name;
 }
 
-UserSymbolIt symbol_user_begin()
+UserSymbolIt symbol_user_begin(const CalcSession& session)
 {
-    UserSymbolIt it = gUserSymbols;
+    UserSymbolIt it = session.Symbols.Symbols;
 
     if (!it->IsUsed)
-        it = symbol_next(it);
+        it = symbol_next(session, it);
 
     return it;
 }
 
-UserSymbolIt symbol_next(UserSymbolIt it)
+UserSymbolIt symbol_next(const CalcSession& session, UserSymbolIt it)
 {
     if (!it)
         return nullptr;
 
-    for (++it; it < gUserSymbols + kMaxUserSymbols; ++it)
+    for (++it; it < session.Symbols.Symbols + kMaxUserSymbols; ++it)
     {
         if (it->IsUsed)
             return it;
@@ -178,12 +183,12 @@ UserSymbolIt symbol_next(UserSymbolIt it)
     return nullptr;
 }
 
-const char* symbol_name(UserSymbolIt it)
+const char* symbol_name(const CalcSession& session, UserSymbolIt it)
 {
     if (!it)
         return "<null>";
 
-    return it->Name;
+    return name_str(session.Names, it->Name);
 }
 
 double symbol_val(UserSymbolIt it)
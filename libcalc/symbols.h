@@ -2,30 +2,61 @@
 
 //-----------------------------------------------------------------------------------------------
 
+#include "names.h"
+
+//-----------------------------------------------------------------------------------------------
+
+struct CalcSession;
 struct ParseCtx;
 
 //-----------------------------------------------------------------------------------------------
 
-bool eval_named_value(const char* name, double& outVal);
+constexpr int kMaxUserSymbols = 25;
+
+struct UserSymbol
+{
+    double Value = 0.0;
+    NameId Name = kInvalidName;
+
+    bool IsUsed = false;
+};
+
+struct SymbolTable
+{
+    UserSymbol Symbols[kMaxUserSymbols];
+
+    // 1 + the index into Symbols for each interned name, or 0 if it's not a user symbol
+    uint8_t ByName[kMaxNames] = {0};
+};
+static_assert(kMaxUserSymbols < 255);
+
+//-----------------------------------------------------------------------------------------------
+
+bool eval_named_value(const CalcSession& session, const char* name, double& outVal);
+
+// only looks at constants like pi
+bool eval_builtin_value(uint32_t hash, const char* name, double& outVal);
+bool eval_builtin_value(const char* name, double& outVal);
+
+// only looks at user-defined symbols; builtins get folded in when expressions are compiled
+bool eval_user_value(const CalcSession& session, NameId name, double& outVal);
 
 bool define_value(const char* name, double val, ParseCtx& ctx);
-void undef_value(const char* name);
 
 //-----------------------------------------------------------------------------------------------
 
 struct SymbolDef;
 using BuiltinSymbolIt = const SymbolDef*;
 
-struct UserSymbol;
 using UserSymbolIt = const UserSymbol*;
 
 BuiltinSymbolIt symbol_builtin_begin();
 BuiltinSymbolIt symbol_next(BuiltinSymbolIt it);
 const char* symbol_name(BuiltinSymbolIt it);
 
-UserSymbolIt symbol_user_begin();
-UserSymbolIt symbol_next(UserSymbolIt it);
-const char* symbol_name(UserSymbolIt it);
+UserSymbolIt symbol_user_begin(const CalcSession& session);
+UserSymbolIt symbol_next(const CalcSession& session, UserSymbolIt it);
+const char* symbol_name(const CalcSession& session, UserSymbolIt it);
 double symbol_val(UserSymbolIt it);
 
 //-----------------------------------------------------------------------------------------------
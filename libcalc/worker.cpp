@@ -0,0 +1,158 @@
+#include "worker.h"
+
+#include "platform.h"
+
+#if MLN_TARGET_PICO
+
+#include "pico/multicore.h"
+
+#include <cstdint>
+
+#else
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#endif
+
+//-------------------------------------------------------------------------------------------------
+
+#if MLN_TARGET_PICO
+
+// core 1's default stack is tiny, and nested user functions can go quite deep
+static uint32_t gCore1Stack[1024];
+
+static bool gCore1Launched = false;
+static bool gJobInFlight = false;
+
+// jobs arrive as a (fn, arg) pair through the inter-core fifo, and we push back when done
+static void core1_main()
+{
+    for (;;)
+    {
+        const WorkerJobFn fn = WorkerJobFn(multicore_fifo_pop_blocking());
+        void* arg = (void*)(multicore_fifo_pop_blocking());
+
+        fn(arg);
+
+        multicore_fifo_push_blocking(1);
+    }
+}
+
+bool worker_try_start(WorkerJobFn fn, void* arg)
+{
+    // only core 0 hands out jobs, so this doesn't need to be atomic
+    if (gJobInFlight)
+        return false;
+
+    if (!gCore1Launched)
+    {
+        multicore_launch_core1_with_stack(core1_main, gCore1Stack, sizeof(gCore1Stack));
+        gCore1Launched = true;
+    }
+
+    gJobInFlight = true;
+    multicore_fifo_push_blocking(uint32_t(fn));
+    multicore_fifo_push_blocking(uint32_t(arg));
+    return true;
+}
+
+void worker_wait()
+{
+    if (!gJobInFlight)
+        return;
+
+    multicore_fifo_pop_blocking();
+    gJobInFlight = false;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+#else
+
+struct WorkerThread
+{
+    // held by whoever owns the worker, from worker_try_start until worker_wait
+    std::mutex OwnerMutex;
+
+    std::mutex JobMutex;
+    std::condition_variable JobCond;
+    WorkerJobFn JobFn = nullptr;
+    void* JobArg = nullptr;
+    bool JobDone = false;
+};
+
+static void worker_main(WorkerThread& worker)
+{
+    std::unique_lock<std::mutex> lock(worker.JobMutex);
+    for (;;)
+    {
+        worker.JobCond.wait(lock, [&]{ return worker.JobFn != nullptr; });
+
+        const WorkerJobFn fn = worker.JobFn;
+        void* arg = worker.JobArg;
+
+        lock.unlock();
+        fn(arg);
+        lock.lock();
+
+        worker.JobFn = nullptr;
+        worker.JobDone = true;
+        worker.JobCond.notify_all();
+    }
+}
+
+// started on first use and never destroyed: the thread is still waiting on it at exit, and
+// tearing down a condition variable with a waiter hangs
+// returns null on single-core machines, where handing work off would only slow it down
+static WorkerThread* get_worker()
+{
+    static WorkerThread* sWorker = []() -> WorkerThread*
+    {
+        if (std::thread::hardware_concurrency() < 2)
+            return nullptr;
+
+        WorkerThread* worker = new WorkerThread;
+        std::thread(worker_main, std::ref(*worker)).detach();
+        return worker;
+    }();
+
+    return sWorker;
+}
+
+bool worker_try_start(WorkerJobFn fn, void* arg)
+{
+    WorkerThread* workerPtr = get_worker();
+    if (!workerPtr)
+        return false;
+
+    WorkerThread& worker = *workerPtr;
+    if (!worker.OwnerMutex.try_lock())
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(worker.JobMutex);
+        worker.JobFn = fn;
+        worker.JobArg = arg;
+        worker.JobDone = false;
+    }
+    worker.JobCond.notify_all();
+    return true;
+}
+
+void worker_wait()
+{
+    WorkerThread& worker = *get_worker();
+    {
+        std::unique_lock<std::mutex> lock(worker.JobMutex);
+        worker.JobCond.wait(lock, [&]{ return worker.JobDone; });
+        worker.JobDone = false;
+    }
+
+    worker.OwnerMutex.unlock();
+}
+
+#endif
+
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,18 @@
+#pragma once
+
+//-------------------------------------------------------------------------------------------------
+
+// runs a job on the pico's second core (or a second thread on other platforms) so the calling
+// core can get on with something else at the same time
+// there's only one worker, so only one job can be in flight at once
+
+typedef void (*WorkerJobFn)(void* arg);
+
+// kicks off fn(arg) on the worker; returns false if the worker is already busy, in which case
+// the caller should just do the work itself
+bool worker_try_start(WorkerJobFn fn, void* arg);
+
+// blocks until the job started by worker_try_start has finished
+void worker_wait();
+
+//-------------------------------------------------------------------------------------------------
@@ -92,6 +92,13 @@ static bool cmd_small(const char*)
 
 //-------------------------------------------------------------------------------------------------
 
+static void get_plot_lcd_row(const void* plot, uint32_t y, uint16_t* row)
+{
+    get_plot_row((const Plot*)plot, (int)y, row);
+}
+
+//-------------------------------------------------------------------------------------------------
+
 
 int main()
 {
@@ -125,7 +132,7 @@ int main()
         const Plot* plot = get_plot();
         if (plot)
         {
-            lcd_put_image(plot->Pixels, MC_PLOT_WIDTH, MC_PLOT_HEIGHT);
+            lcd_put_image_rows(plot, get_plot_lcd_row, MC_PLOT_WIDTH, MC_PLOT_HEIGHT);
         }
     }
 }